@@ -1,15 +1,178 @@
 #include <math.h>
+#include <stdexcept>
+#include <algorithm>
+#include <chrono>
+#include <climits>
 #include "AStar.h"
+#include "ParallelAStar.h"
+#include "ExternalAStar.h"
 
 using namespace std;
 using namespace PuzzleBoard;
 
+namespace
+{
+    // Random bits for a tile at an index, mixed by the SplitMix64 finaliser
+    // so no table of N^4 numbers has to be kept
+    uint64_t zobrist_bits(int index, int tile)
+    {
+        uint64_t z = (static_cast<uint64_t>(index) << 16 | static_cast<uint64_t>(tile)) + 0x9E3779B97F4A7C15;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+        return z ^ (z >> 31);
+    }
+
+    // Default options but for the heuristic
+    SolverOptions options_with(Heuristic heuristic)
+    {
+        SolverOptions options;
+        options.heuristic = heuristic;
+        return options;
+    }
+
+    using HeuristicSearch::ScopedTimer;
+}
+
+
+#pragma region Heuristics
+
+WalkingDistance::WalkingDistance(int n) : N(n)
+{
+    if (n < 2 || n > max_dimension) {
+        throw invalid_argument("WalkingDistance: n should be within [2, 4]!");
+    }
+
+    // In the goal state every line holds its own tiles, and the last line
+    // holds the empty tile as well
+    vector<int> count(N * N, 0);
+    for (int i = 0; i < N; ++i) {
+        count[i * N + i] = (i == N - 1) ? N - 1 : N;
+    }
+    uint64_t goal = key(N, count.data(), N - 1);
+
+    // Breadth-first search from the goal state, all moves are reversible
+    vector<uint64_t> queue;
+    queue.push_back(goal);
+    distances[goal] = 0;
+
+    for (size_t head = 0; head < queue.size(); ++head) {
+        uint64_t current = queue[head];
+        int distance = distances[current];
+        int blank_line = static_cast<int>(current >> (3 * N * (N - 1)));
+
+        // Slide a tile of any goal line from the line above or below
+        // into the line of the empty tile
+        for (int line = blank_line - 1; line <= blank_line + 1; line += 2) {
+            if (line < 0 || line > N - 1) {
+                continue;
+            }
+
+            int last_group = N;
+            for (int j = 0; j < N - 1; ++j) {
+                int tiles = static_cast<int>(current >> (3 * (line * (N - 1) + j)) & 7);
+                last_group -= tiles;
+                if (tiles > 0) {
+                    uint64_t next = moved(current, N, line, blank_line, j);
+                    if (distances.emplace(next, distance + 1).second) {
+                        queue.push_back(next);
+                    }
+                }
+            }
+            if (last_group > 0) {
+                uint64_t next = moved(current, N, line, blank_line, N - 1);
+                if (distances.emplace(next, distance + 1).second) {
+                    queue.push_back(next);
+                }
+            }
+        }
+    }
+}
+
+const WalkingDistance& WalkingDistance::table(int n)
+{
+    // Each table is built once by whichever thread asks for it first,
+    // and is only read afterwards
+    switch (n) {
+    case 2: {
+        static const WalkingDistance table2(2);
+        return table2;
+    }
+    case 3: {
+        static const WalkingDistance table3(3);
+        return table3;
+    }
+    case 4: {
+        static const WalkingDistance table4(4);
+        return table4;
+    }
+    default:
+        throw invalid_argument("WalkingDistance: n should be within [2, 4]!");
+    }
+}
+
+int WalkingDistance::distance(uint64_t key) const
+{
+    return distances.at(key);
+}
+
+uint64_t WalkingDistance::key(int n, const int* count, int blank_line)
+{
+    uint64_t key = static_cast<uint64_t>(blank_line) << (3 * n * (n - 1));
+    for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n - 1; ++j) {
+            key |= static_cast<uint64_t>(count[i * n + j]) << (3 * (i * (n - 1) + j));
+        }
+    }
+    return key;
+}
+
+uint64_t WalkingDistance::moved(uint64_t key, int n, int from_line, int to_line, int goal_line)
+{
+    // Counts of the last goal line are implied, so only the others are kept
+    if (goal_line < n - 1) {
+        key -= static_cast<uint64_t>(1) << (3 * (from_line * (n - 1) + goal_line));
+        key += static_cast<uint64_t>(1) << (3 * (to_line * (n - 1) + goal_line));
+    }
+
+    // The empty tile takes the place of the moved tile
+    int shift = 3 * n * (n - 1);
+    key &= ~(static_cast<uint64_t>(7) << shift);
+    key |= static_cast<uint64_t>(from_line) << shift;
+
+    return key;
+}
+
+#pragma endregion Heuristics
+
 
 #pragma region Board
 
 Board::Board(const vector<int>& tiles)
-    : tiles(tiles), N(static_cast<int>(sqrt(tiles.size())))
+    : tiles(tiles), N(static_cast<int>(sqrt(tiles.size()))), blank(0)
 {
+    for (int i = 0; i < N * N; ++i) {
+        if (tiles[i] == 0) {
+            blank = i;
+        }
+        else {
+            zobrist ^= zobrist_bits(i, tiles[i]);
+        }
+    }
+
+    // Keep walking distance states so they can be updated move by move
+    if (N <= WalkingDistance::max_dimension) {
+        int row_count[WalkingDistance::max_dimension * WalkingDistance::max_dimension] = {};
+        int column_count[WalkingDistance::max_dimension * WalkingDistance::max_dimension] = {};
+        for (int i = 0; i < N * N; ++i) {
+            if (tiles[i] == 0) {
+                continue;
+            }
+            ++row_count[i / N * N + (tiles[i] - 1) / N];
+            ++column_count[i % N * N + (tiles[i] - 1) % N];
+        }
+        row_key = WalkingDistance::key(N, row_count, blank / N);
+        column_key = WalkingDistance::key(N, column_count, blank % N);
+    }
 }
 
 int Board::dimension() const
@@ -59,59 +222,254 @@ int Board::manhattan() const
     return distance;
 }
 
-bool Board::is_goal() const
+int Board::linear_conflict() const
 {
-    return hamming() == 0;
+    int conflicts = 0;
+    for (int line = 0; line < N; ++line) {
+        conflicts += line_conflicts(line, true, -1);
+        conflicts += line_conflicts(line, false, -1);
+    }
+
+    return manhattan() + 2 * conflicts;
 }
 
-bool Board::equals(const Board& other) const
+int Board::walking_distance() const
 {
-    return string_representation() == other.string_representation();
+    const WalkingDistance& table = WalkingDistance::table(N);
+    return table.distance(row_key) + table.distance(column_key);
 }
 
-vector<Board> Board::neighbours() const
+int Board::heuristic(Heuristic h) const
 {
-    vector<Board> neighbours;
+    switch (h) {
+    case Heuristic::hamming:
+        return hamming();
+    case Heuristic::manhattan:
+        return manhattan();
+    case Heuristic::linear_conflict:
+        return linear_conflict();
+    case Heuristic::walking_distance:
+        return walking_distance();
+    }
+
+    return 0;
+}
+
+int Board::heuristic_delta(Heuristic h, int index) const
+{
+    int goal = tiles[index] - 1;
+
+    if (h == Heuristic::hamming) {
+        return (goal != blank) - (goal != index);
+    }
+
+    // A vertical move changes the row of the tile but keeps the order of
+    // tiles in its column, and the other way round for a horizontal move
+    bool is_vertical = index % N == blank % N;
+    int from_line = is_vertical ? index / N : index % N;
+    int to_line = is_vertical ? blank / N : blank % N;
+    int goal_line = is_vertical ? goal / N : goal % N;
+
+    if (h == Heuristic::walking_distance) {
+        const WalkingDistance& table = WalkingDistance::table(N);
+        uint64_t key = is_vertical ? row_key : column_key;
+        uint64_t next = WalkingDistance::moved(key, N, from_line, to_line, goal_line);
+        return table.distance(next) - table.distance(key);
+    }
+
+    int delta = abs(to_line - goal_line) - abs(from_line - goal_line);
+    if (h == Heuristic::linear_conflict) {
+        delta += 2 * (line_conflicts(from_line, is_vertical, index)
+                      + line_conflicts(to_line, is_vertical, index)
+                      - line_conflicts(from_line, is_vertical, -1)
+                      - line_conflicts(to_line, is_vertical, -1));
+    }
+
+    return delta;
+}
+
+int Board::blank_position() const
+{
+    return blank;
+}
+
+int Board::tile(int index) const
+{
+    return tiles[index];
+}
+
+uint64_t Board::hash() const
+{
+    return zobrist;
+}
+
+string Board::key(const vector<int>* labels) const
+{
+    // Tiles take one byte when they fit, and two otherwise
+    int width = N * N <= 256 ? 1 : 2;
+    string key(N * N * width, '\0');
 
-    // Find the index of 0
-    int index = 0;
     for (int i = 0; i < N * N; ++i) {
-        if (tiles[i] == 0) {
-            index = i;
-            break;
+        int tile = labels != nullptr ? (*labels)[tiles[i]] : tiles[i];
+        key[i * width] = static_cast<char>(tile & 0xFF);
+        if (width == 2) {
+            key[i * width + 1] = static_cast<char>(tile >> 8);
         }
     }
-    int row = index / N + 1;
-    int col = index % N + 1;
 
-    // A neighbour is created by swapping 0 with its adjacent tile
-    if (row > 1) {
-        vector<int> neighbour_tiles(tiles);
-        swap(neighbour_tiles[index], neighbour_tiles[index - N]);
+    return key;
+}
+
+Board Board::from_key(const string& key)
+{
+    // Two byte keys hold more than 256 tiles, so more than 512 bytes
+    int width = key.size() <= 256 ? 1 : 2;
+    vector<int> tiles(key.size() / width);
+
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        tiles[i] = static_cast<unsigned char>(key[i * width]);
+        if (width == 2) {
+            tiles[i] |= static_cast<unsigned char>(key[i * width + 1]) << 8;
+        }
+    }
+
+    return Board(tiles);
+}
+
+bool Board::can_move(Move move) const
+{
+    switch (move) {
+    case Move::up:
+        return blank >= N;
+    case Move::down:
+        return blank < N * N - N;
+    case Move::left:
+        return blank % N > 0;
+    case Move::right:
+        return blank % N < N - 1;
+    }
+
+    return false;
+}
+
+int Board::moved_tile_position(Move move) const
+{
+    switch (move) {
+    case Move::up:
+        return blank - N;
+    case Move::down:
+        return blank + N;
+    case Move::left:
+        return blank - 1;
+    case Move::right:
+        return blank + 1;
+    }
+
+    return blank;
+}
+
+void Board::move(Move move)
+{
+    int index = moved_tile_position(move);
+    int goal = tiles[index] - 1;
+
+    if (N <= WalkingDistance::max_dimension) {
+        if (move == Move::up || move == Move::down) {
+            row_key = WalkingDistance::moved(row_key, N, index / N, blank / N, goal / N);
+        }
+        else {
+            column_key = WalkingDistance::moved(column_key, N, index % N, blank % N, goal % N);
+        }
+    }
+
+    zobrist ^= zobrist_bits(index, tiles[index]) ^ zobrist_bits(blank, tiles[index]);
+    swap(tiles[index], tiles[blank]);
+    blank = index;
+}
+
+int Board::line_conflicts(int line, bool is_row, int index) const
+{
+    // Tails of increasing runs of goal positions, longest run so far is `length`
+    int tails[128];
+    int length = 0;
+    int count = 0;
+
+    for (int k = 0; k < N; ++k) {
+        int i = is_row ? line * N + k : k * N + line;
+        int tile = tiles[i];
+        if (index >= 0) {
+            if (i == blank) {
+                tile = tiles[index];
+            }
+            else if (i == index) {
+                tile = 0;
+            }
+        }
+        if (tile == 0) {
+            continue;
+        }
+
+        int goal_line = is_row ? (tile - 1) / N : (tile - 1) % N;
+        if (goal_line != line) {
+            continue;
+        }
+        int goal = is_row ? (tile - 1) % N : (tile - 1) / N;
+        ++count;
 
-        Board neighbour(neighbour_tiles);
-        neighbours.push_back(neighbour);
+        int position = static_cast<int>(lower_bound(tails, tails + length, goal) - tails);
+        tails[position] = goal;
+        if (position == length) {
+            ++length;
+        }
     }
-    if (row < N) {
-        vector<int> neighbour_tiles(tiles);
-        swap(neighbour_tiles[index], neighbour_tiles[index + N]);
 
-        Board neighbour(neighbour_tiles);
-        neighbours.push_back(neighbour);
+    // Tiles outside the longest run have to leave the line and come back
+    return count - length;
+}
+
+bool Board::is_goal() const
+{
+    return hamming() == 0;
+}
+
+bool Board::is_solvable() const
+{
+    // Inversions among the tiles, leaving out the empty tile
+    vector<int> order;
+    order.reserve(N * N - 1);
+    for (int i = 0; i < N * N; ++i) {
+        if (tiles[i] != 0) {
+            order.push_back(tiles[i]);
+        }
     }
-    if (col > 1) {
-        vector<int> neighbour_tiles(tiles);
-        swap(neighbour_tiles[index], neighbour_tiles[index - 1]);
+    long long inversions = Sorting::count_inversions(order, 0, N * N - 2, N * N - 1);
 
-        Board neighbour(neighbour_tiles);
-        neighbours.push_back(neighbour);
+    // A horizontal move keeps the order of tiles. A vertical move carries
+    // a tile past N - 1 others, so for even N it flips the inversion parity
+    // and the parity of the row of the empty tile at the same time.
+    if (N % 2 == 1) {
+        return inversions % 2 == 0;
     }
-    if (col < N) {
-        vector<int> neighbour_tiles(tiles);
-        swap(neighbour_tiles[index], neighbour_tiles[index + 1]);
+    return (inversions + N - 1 - blank / N) % 2 == 0;
+}
+
+bool Board::equals(const Board& other) const
+{
+    return string_representation() == other.string_representation();
+}
+
+vector<Board> Board::neighbours() const
+{
+    const Move directions[] = { Move::up, Move::down, Move::left, Move::right };
+    vector<Board> neighbours;
+    neighbours.reserve(4);
 
-        Board neighbour(neighbour_tiles);
-        neighbours.push_back(neighbour);
+    // A neighbour is created by swapping 0 with its adjacent tile
+    for (Move direction : directions) {
+        if (can_move(direction)) {
+            neighbours.push_back(*this);
+            neighbours.back().move(direction);
+        }
     }
 
     return neighbours;
@@ -139,58 +497,307 @@ Board Board::twin() const
 #pragma endregion Board
 
 
+#pragma region Solution
+
+MoveSequence::MoveSequence(const vector<Move>& moves)
+{
+    bits.reserve((moves.size() + 3) / 4);
+    for (Move move : moves) {
+        push_back(move);
+    }
+}
+
+MoveSequence MoveSequence::from_string(const string& letters)
+{
+    static const string names = "UDLR";
+    MoveSequence sequence;
+
+    for (char letter : letters) {
+        size_t move = names.find(letter);
+        if (move == string::npos) {
+            throw invalid_argument("MoveSequence: moves should be written as U, D, L or R!");
+        }
+        sequence.push_back(static_cast<Move>(move));
+    }
+
+    return sequence;
+}
+
+void MoveSequence::push_back(Move move)
+{
+    if ((count & 3) == 0) {
+        bits.push_back(0);
+    }
+    bits.back() |= static_cast<unsigned char>(move) << ((count & 3) * 2);
+    ++count;
+}
+
+size_t MoveSequence::size() const
+{
+    return count;
+}
+
+bool MoveSequence::empty() const
+{
+    return count == 0;
+}
+
+string MoveSequence::to_string() const
+{
+    static const char names[] = "UDLR";
+    string letters(count, '\0');
+
+    for (size_t i = 0; i < count; ++i) {
+        letters[i] = names[static_cast<int>((*this)[i])];
+    }
+
+    return letters;
+}
+
+SolutionPath::SolutionPath(const Board& initial, const MoveSequence& moves, bool solvable)
+    : initial(initial), sequence(moves), boards(solvable ? moves.size() + 1 : 0)
+{
+}
+
+SolutionPath::Iterator SolutionPath::begin() const
+{
+    return Iterator(initial, &sequence, 0);
+}
+
+SolutionPath::Iterator SolutionPath::end() const
+{
+    return Iterator(initial, &sequence, boards);
+}
+
+size_t SolutionPath::size() const
+{
+    return boards;
+}
+
+const MoveSequence& SolutionPath::moves() const
+{
+    return sequence;
+}
+
+#pragma endregion Solution
+
+
 #pragma region Solver
 
-Solver::Solver(const Board& initial)
+Solver::Solver(const Board& initial, Heuristic heuristic)
+    : Solver(initial, options_with(heuristic))
 {
-    Node node(initial, nullptr, 0, initial.manhattan());
-    Node node2(initial.twin(), nullptr, 0, initial.twin().manhattan());
-    pq.push(node);
-    pq2.push(node2);
+}
 
-    a_star();
+Solver::Solver(const Board& initial, Heuristic heuristic, Workspace& workspace)
+    : Solver(initial, options_with(heuristic), workspace)
+{
 }
 
-void Solver::a_star()
+Solver::Solver(const Board& initial, const SolverOptions& options)
+    : initial(initial), heuristic(options.heuristic), mode(options.mode),
+      threads(options.threads), memory_limit(options.memory_limit),
+      temp_directory(options.temp_directory), current(initial)
 {
-    while (true) {
-        Node node = pq.pop_min();
-        Node node2 = pq2.pop_min();
+    Workspace workspace;
+    solve(workspace);
+}
 
-        if (node.board.is_goal()) {
-            solvable = true;
-            number_of_moves = node.moves;
-            game_tree.push_back(node);
-            break;
+Solver::Solver(const Board& initial, const SolverOptions& options, Workspace& workspace)
+    : initial(initial), heuristic(options.heuristic), mode(options.mode),
+      threads(options.threads), memory_limit(options.memory_limit),
+      temp_directory(options.temp_directory), current(initial)
+{
+    solve(workspace);
+}
+
+void Solver::solve(Workspace& workspace)
+{
+    // Unsolvable boards are ruled out by parity, so only the real
+    // search has to run
+    solvable = initial.is_solvable();
+    if (!solvable) {
+        return;
+    }
+
+    SOLVER_STATS(ScopedTimer timer(stats.search_seconds));
+    if (mode == SearchMode::bidirectional) {
+        bidirectional(workspace);
+        return;
+    }
+    if (mode == SearchMode::parallel) {
+        number_of_moves = parallel_a_star(initial, heuristic, threads, moves, stats);
+        return;
+    }
+    if (mode == SearchMode::external) {
+        number_of_moves = external_a_star(initial, heuristic, memory_limit, temp_directory, moves, stats);
+        return;
+    }
+
+    Domain domain{ heuristic };
+    HeuristicSearch::EngineStats search_stats;
+    number_of_moves = workspace.engine.search(domain, initial, moves, search_stats);
+
+    SOLVER_STATS(stats.nodes_generated = search_stats.nodes_generated);
+    SOLVER_STATS(stats.nodes_expanded = search_stats.nodes_expanded);
+    SOLVER_STATS(stats.duplicates_pruned = search_stats.duplicates_pruned);
+    SOLVER_STATS(stats.peak_open_set = search_stats.peak_open_set);
+    SOLVER_STATS(stats.peak_node_memory = search_stats.peak_node_memory);
+    SOLVER_STATS(stats.heuristic_seconds = search_stats.heuristic_seconds);
+    SOLVER_STATS(stats.heap_seconds = search_stats.heap_seconds);
+    SOLVER_STATS(stats.neighbour_seconds = search_stats.neighbour_seconds);
+}
+
+void Solver::bidirectional(Workspace& workspace)
+{
+    // The backward search runs on boards relabelled so that the initial
+    // board becomes the goal board: a tile is written as its initial index
+    // plus 1. Goal based heuristics then estimate the moves left to the
+    // initial board. Walking distance tables assume the empty tile ends in
+    // the last row, so linear conflict stands in for them backwards.
+    int size = initial.dimension() * initial.dimension();
+    vector<int> relabel(size, 0);
+    vector<int> unlabel(size + 1, 0);
+    for (int i = 0; i < size; ++i) {
+        if (initial.tile(i) != 0) {
+            relabel[initial.tile(i)] = i + 1;
+            unlabel[i + 1] = initial.tile(i);
         }
-        if (node2.board.is_goal()) {
-            game_tree.clear();
+    }
+    vector<int> goal_tiles(size, 0);
+    for (int i = 0; i < size - 1; ++i) {
+        goal_tiles[i] = relabel[i + 1];
+    }
+
+    const Board starts[2] = { initial, Board(goal_tiles) };
+    const Heuristic heuristics[2] = {
+        heuristic,
+        heuristic == Heuristic::walking_distance ? Heuristic::linear_conflict : heuristic
+    };
+    const vector<int>* labels[2] = { nullptr, &unlabel };
+
+    // Best solution found so far, through the meeting nodes of each direction
+    int best = INT_MAX;
+    uint32_t meeting[2] = { GameTree::none, GameTree::none };
+
+    for (int d = 0; d < 2; ++d) {
+        Frontier& frontier = workspace.frontiers[d];
+        frontier.pq.clear();
+        frontier.game_tree.clear();
+        frontier.visited.clear();
+
+        uint32_t root = frontier.game_tree.add(TreeNode{ GameTree::none, Move::up });
+        int estimate = starts[d].heuristic(heuristics[d]);
+        frontier.pq.push(FrontierEntry{ estimate, 0, estimate, root });
+        frontier.visited[starts[d].key(labels[d])] = Visit{ 0, root };
+        SOLVER_STATS(++stats.nodes_generated);
+    }
+    auto meet = workspace.frontiers[1].visited.find(initial.key());
+    if (meet != workspace.frontiers[1].visited.end()) {
+        best = meet->second.moves;
+        meeting[0] = 0;
+        meeting[1] = meet->second.node;
+    }
+
+    while (!workspace.frontiers[0].pq.is_empty() && !workspace.frontiers[1].pq.is_empty()) {
+        // No path through the frontiers can be shorter than the smallest
+        // priority, so a solution that short is optimal
+        int forward_min = workspace.frontiers[0].pq.min().priority;
+        int backward_min = workspace.frontiers[1].pq.min().priority;
+        if (best <= min(forward_min, backward_min)) {
             break;
         }
 
-        game_tree.push_back(node);
-        Node& current = game_tree.back();
+        // Expand the direction with the smaller priority
+        int d = forward_min <= backward_min ? 0 : 1;
+        Frontier& frontier = workspace.frontiers[d];
+        Frontier& other = workspace.frontiers[1 - d];
 
-        vector<Board> boards = current.board.neighbours();
-        for (Board board : boards) {
-            if (current.prev != nullptr && board.equals(current.prev->board)) {
-                continue;
-            }
-            Node new_node(board, &current, current.moves + 1, board.manhattan());
-            pq.push(new_node);
+        FrontierEntry entry;
+        {
+            SOLVER_STATS(ScopedTimer timer(stats.heap_seconds));
+            entry = frontier.pq.pop_min();
+        }
+        {
+            SOLVER_STATS(ScopedTimer timer(stats.neighbour_seconds));
+            rebuild(frontier.game_tree, workspace.path, starts[d], entry.node);
+        }
+
+        // Skip entries of boards that were reached in fewer moves later
+        if (frontier.visited[current.key(labels[d])].moves < entry.moves) {
+            continue;
         }
+        TreeNode node = frontier.game_tree[entry.node];
+        SOLVER_STATS(++stats.nodes_expanded);
 
-        game_tree2.push_back(node2);
-        Node& current2 = game_tree2.back();
+        auto visit = [&](const Board& neighbour, Move move, int, int delta) {
+            int moves = entry.moves + 1;
+            string key = neighbour.key(labels[d]);
 
-        vector<Board> boards2 = current2.board.neighbours();
-        for (Board board2 : boards2) {
-            if (current2.prev != nullptr && board2.equals(current2.prev->board)) {
-                continue;
+            auto seen = frontier.visited.find(key);
+            if (seen != frontier.visited.end() && seen->second.moves <= moves) {
+                SOLVER_STATS(++stats.duplicates_pruned);
+                return;
+            }
+
+            uint32_t child = frontier.game_tree.add(TreeNode{ entry.node, move });
+            frontier.visited[key] = Visit{ moves, child };
+            int estimate = entry.estimate + delta;
+            {
+                SOLVER_STATS(ScopedTimer timer(stats.heap_seconds));
+                frontier.pq.push(FrontierEntry{ max(moves + estimate, 2 * moves), moves, estimate, child });
+            }
+            SOLVER_STATS(++stats.nodes_generated);
+
+            // The frontiers meet at boards seen from both directions
+            auto meet = other.visited.find(key);
+            if (meet != other.visited.end() && moves + meet->second.moves < best) {
+                best = moves + meet->second.moves;
+                meeting[d] = child;
+                meeting[1 - d] = meet->second.node;
             }
-            Node new_node(board2, &current2, current2.moves + 1, board2.manhattan());
-            pq2.push(new_node);
+        };
+
+        if (node.parent == GameTree::none) {
+            current.for_each_neighbour(heuristics[d], visit);
+        }
+        else {
+            current.for_each_neighbour(heuristics[d], PuzzleBoard::reverse(node.move), visit);
         }
+
+        SOLVER_STATS(stats.peak_open_set = max(stats.peak_open_set,
+            static_cast<size_t>(frontier.pq.size() + other.pq.size())));
+        SOLVER_STATS(stats.peak_node_memory = max(stats.peak_node_memory,
+            frontier.game_tree.memory() + other.game_tree.memory()
+            + (frontier.pq.size() + other.pq.size()) * sizeof(FrontierEntry)));
+    }
+
+    // Moves from the initial board to the meeting board, then the reverse
+    // of the backward moves from there back to the goal board
+    number_of_moves = best;
+    moves.clear();
+    const GameTree& forward_tree = workspace.frontiers[0].game_tree;
+    for (uint32_t i = meeting[0]; forward_tree[i].parent != GameTree::none; i = forward_tree[i].parent) {
+        moves.push_back(forward_tree[i].move);
+    }
+    std::reverse(moves.begin(), moves.end());
+    const GameTree& backward_tree = workspace.frontiers[1].game_tree;
+    for (uint32_t i = meeting[1]; backward_tree[i].parent != GameTree::none; i = backward_tree[i].parent) {
+        moves.push_back(PuzzleBoard::reverse(backward_tree[i].move));
+    }
+}
+
+void Solver::rebuild(const GameTree& game_tree, vector<Move>& path, const Board& start, uint32_t node)
+{
+    path.clear();
+    for (uint32_t i = node; game_tree[i].parent != GameTree::none; i = game_tree[i].parent) {
+        path.push_back(game_tree[i].move);
+    }
+
+    // Assigning keeps the tile buffer of the current board
+    current = start;
+    for (auto move = path.rbegin(); move != path.rend(); ++move) {
+        current.move(*move);
     }
 }
 
@@ -204,20 +811,25 @@ bool Solver::is_solvable() const
     return solvable;
 }
 
+const SolverStats& Solver::statistics() const
+{
+    return stats;
+}
+
 deque<Board> Solver::solution() const
 {
-    deque<Board> solution_boards;
+    SolutionPath path = solution_path();
+    return deque<Board>(path.begin(), path.end());
+}
 
-    if (is_solvable()) {
-        Node goal = game_tree.back();
-        solution_boards.push_front(goal.board);
-        while (goal.prev != nullptr) {
-            goal = *(goal.prev);
-            solution_boards.push_front(goal.board);
-        }
-    }
+MoveSequence Solver::solution_moves() const
+{
+    return MoveSequence(moves);
+}
 
-    return solution_boards;
+SolutionPath Solver::solution_path() const
+{
+    return SolutionPath(initial, solution_moves(), is_solvable());
 }
 
 #pragma endregion Solver
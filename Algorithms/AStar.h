@@ -3,13 +3,75 @@
 #include <string>
 #include <vector>
 #include <deque>
+#include <unordered_map>
+#include <memory>
+#include <iterator>
+#include <stdint.h>
 #include "Sorting.h"
+#include "AStarEngine.h"
 
 namespace PuzzleBoard
 {
 
+#pragma region Heuristics
+
+    // Admissible estimates of the number of moves left to reach the goal
+    enum class Heuristic {
+        hamming,          // Number of tiles out of place
+        manhattan,        // Sum of Manhattan distances between tiles and goal
+        linear_conflict,  // Manhattan distance plus 2 moves for each tile that
+                          // has to leave its goal row or column to let others pass
+        walking_distance  // Takahashi's walking distance, N should be within [2, 4]
+    };
+
+    // Table of walking distances for an N-by-N board.
+    // The vertical state of a board counts, for each row, how many of its tiles
+    // belong to each goal row. The walking distance of that state is the number
+    // of vertical moves needed to reach the goal state when tiles of the same
+    // goal row are indistinguishable. The horizontal state is the same with
+    // columns, so one table serves both directions.
+    class WalkingDistance {
+    public:
+        // Tables grow to millions of states from N = 5
+        static const int max_dimension = 4;
+
+        // Shared read-only table for dimension n, built on first use
+        static const WalkingDistance& table(int n);
+
+        // Walking distance of a vertical or horizontal state key
+        int distance(uint64_t key) const;
+
+        // A state key packs 3-bit counts of tiles in each line by goal line,
+        // leaving out the last goal line which is implied by the line length,
+        // followed by the line that holds the empty tile.
+        // Key of the state where line i holds count[i * n + j] tiles of goal line j
+        static uint64_t key(int n, const int* count, int blank_line);
+
+        // Key of the state where a tile of goal_line slides from from_line
+        // into the empty square at to_line.
+        static uint64_t moved(uint64_t key, int n, int from_line, int to_line, int goal_line);
+
+    private:
+        WalkingDistance(int n);
+
+        const int N;
+        std::unordered_map<uint64_t, unsigned char> distances;
+    };
+
+#pragma endregion Heuristics
+
+
 #pragma region Board
 
+    // Directions the empty tile can move in
+    enum class Move : unsigned char { up, down, left, right };
+
+    // The move that undoes this move
+    inline Move reverse(Move move)
+    {
+        return static_cast<Move>(static_cast<unsigned char>(move) ^ 1);
+    }
+
     class Board {
     public:
         // Create a board from an array of tiles from 0 to N^2 - 1, where
@@ -29,32 +91,262 @@ namespace PuzzleBoard
         // Sum of Manhattan distances between tiles and goal
         int manhattan() const;
 
+        // Manhattan distance plus 2 for each tile that has to leave its goal
+        // line, found from the longest increasing run of goal positions
+        int linear_conflict() const;
+
+        // Vertical plus horizontal walking distance, N should be within [2, 4]
+        int walking_distance() const;
+
+        // Value of the chosen heuristic
+        int heuristic(Heuristic h) const;
+
+        // Change of the chosen heuristic if the tile at index slides into the
+        // empty square. Only the lines that the tile leaves and enters are
+        // looked at, so this is much cheaper than evaluating the new board.
+        int heuristic_delta(Heuristic h, int index) const;
+
+        // Index of the empty tile
+        int blank_position() const;
+
+        // Tile at index
+        int tile(int index) const;
+
+        // Zobrist hash of the tiles, kept up to date move by move
+        uint64_t hash() const;
+
+        // Compact string of the tiles for use as a hash map key, with tile t
+        // written as labels[t] if labels are given
+        std::string key(const std::vector<int>* labels = nullptr) const;
+
+        // Board of a key made without labels
+        static Board from_key(const std::string& key);
+
+        // Can the empty tile move in this direction?
+        bool can_move(Move move) const;
+
+        // Index of the tile that slides into the empty square on this move
+        int moved_tile_position(Move move) const;
+
+        // Move the empty tile in place, the move should be possible
+        void move(Move move);
+
         // Is this board the goal board?
         bool is_goal() const;
 
+        // Can this board reach the goal board?
+        // Decided by permutation parity in O(N^2 log N) time
+        bool is_solvable() const;
+
         // Does this board equal the other board?
         bool equals(const Board& other) const;
 
         // All neighbouring boards
         std::vector<Board> neighbours() const;
 
+        // Visit all neighbouring boards without allocating any of them.
+        // Each move is made in place and visit(board, move, blank, delta) is
+        // called with this board as the neighbour, the new index of the empty
+        // tile and the change of heuristic h, then the move is undone.
+        template <class Visitor>
+        void for_each_neighbour(Heuristic h, Visitor&& visit)
+        {
+            visit_neighbours(h, visit, -1);
+        }
+
+        // Same as above, but leave out one move, usually the reverse of
+        // the move that led to this board
+        template <class Visitor>
+        void for_each_neighbour(Heuristic h, Move excluded, Visitor&& visit)
+        {
+            visit_neighbours(h, visit, static_cast<int>(excluded));
+        }
+
         // A board that is obtained by exchanging any pair of tiles
         Board twin() const;
 
     private:
         std::vector<int> tiles;
         int N;
+        int blank;
+        uint64_t row_key = 0;     // Vertical walking distance state
+        uint64_t column_key = 0;  // Horizontal walking distance state
+        uint64_t zobrist = 0;
+
+        // Tiles that have to leave row or column `line` so that the others
+        // are in goal order, with the tile at index moved to the empty square
+        // if index is not negative
+        int line_conflicts(int line, bool is_row, int index) const;
+
+        template <class Visitor>
+        void visit_neighbours(Heuristic h, Visitor& visit, int excluded)
+        {
+            const Move directions[] = { Move::up, Move::down, Move::left, Move::right };
+            for (Move direction : directions) {
+                if (static_cast<int>(direction) == excluded || !can_move(direction)) {
+                    continue;
+                }
+
+                int delta = heuristic_delta(h, moved_tile_position(direction));
+                move(direction);
+                visit(static_cast<const Board&>(*this), direction, blank, delta);
+                move(reverse(direction));
+            }
+        }
     };
 
 #pragma endregion Board
 
 
+#pragma region Solution
+
+    // Moves of the empty tile packed two bits each, so a solution of 60
+    // moves takes 15 bytes instead of 61 boards
+    class MoveSequence {
+    public:
+        MoveSequence() = default;
+        explicit MoveSequence(const std::vector<Move>& moves);
+
+        // Read letters U, D, L and R, as written by to_string()
+        static MoveSequence from_string(const std::string& letters);
+
+        void push_back(Move move);
+
+        Move operator[](size_t index) const
+        {
+            return static_cast<Move>((bits[index >> 2] >> ((index & 3) * 2)) & 3);
+        }
+
+        // Number of moves
+        size_t size() const;
+        bool empty() const;
+
+        // One letter for each move, U, D, L or R
+        std::string to_string() const;
+
+    private:
+        std::vector<unsigned char> bits;
+        size_t count = 0;
+    };
+
+    // Boards of a solution, rebuilt one at a time by replaying the moves on
+    // the initial board as the iterator moves forward
+    class SolutionPath {
+    public:
+        class Iterator {
+        public:
+            typedef std::input_iterator_tag iterator_category;
+            typedef Board value_type;
+            typedef std::ptrdiff_t difference_type;
+            typedef const Board* pointer;
+            typedef const Board& reference;
+
+            const Board& operator*() const { return board; }
+            const Board* operator->() const { return &board; }
+
+            Iterator& operator++()
+            {
+                if (index < moves->size()) {
+                    board.move((*moves)[index]);
+                }
+                ++index;
+                return *this;
+            }
+
+            bool operator==(const Iterator& other) const { return index == other.index; }
+            bool operator!=(const Iterator& other) const { return index != other.index; }
+
+        private:
+            friend class SolutionPath;
+
+            Iterator(const Board& board, const MoveSequence* moves, size_t index)
+                : board(board), moves(moves), index(index) {}
+
+            Board board;
+            const MoveSequence* moves;
+            size_t index;  // Moves replayed so far
+        };
+
+        // The path of an unsolvable board holds no boards at all
+        SolutionPath(const Board& initial, const MoveSequence& moves, bool solvable = true);
+
+        Iterator begin() const;
+        Iterator end() const;
+
+        // Number of boards, one more than the number of moves
+        size_t size() const;
+
+        const MoveSequence& moves() const;
+
+    private:
+        Board initial;
+        MoveSequence sequence;
+        size_t boards;
+    };
+
+#pragma endregion Solution
+
+
 #pragma region A* Solver
 
+    // Instrumentation of a search loop, which compiles to nothing unless
+    // PUZZLE_SOLVER_STATS is defined
+#ifdef PUZZLE_SOLVER_STATS
+#define SOLVER_STATS(statement) statement
+#else
+#define SOLVER_STATS(statement)
+#endif
+
+    // Counters and timers of one search. They are only filled when the
+    // solver is built with PUZZLE_SOLVER_STATS defined, otherwise they stay
+    // zero and the search loop carries no instrumentation at all.
+    struct SolverStats {
+        uint64_t nodes_generated = 0;
+        uint64_t nodes_expanded = 0;
+        uint64_t duplicates_pruned = 0;  // Children dropped for a board already reached in
+                                         // as few moves. Moves straight back to the parent
+                                         // are never generated, so they are not counted.
+        size_t peak_open_set = 0;
+        size_t peak_node_memory = 0;     // Bytes of game tree and open set
+        double heuristic_seconds = 0.0;  // Evaluating heuristics and moving tiles
+        double heap_seconds = 0.0;       // Pushing to and popping from the open set
+        double neighbour_seconds = 0.0;  // Rebuilding boards and adding children
+        double search_seconds = 0.0;     // The whole search
+    };
+
+    // Ways of searching for a shortest solution
+    enum class SearchMode {
+        a_star,         // A* from the initial board
+        bidirectional,  // MM search from both the initial and the goal board,
+                        // which meet in the middle
+        parallel,       // Hash-distributed A* on several threads
+        external        // A* with the open and closed sets kept on disk
+    };
+
+    struct SolverOptions {
+        Heuristic heuristic = Heuristic::manhattan;
+        SearchMode mode = SearchMode::a_star;
+        int threads = 0;  // Threads of a parallel search, 0 for one per hardware thread
+        size_t memory_limit = size_t(256) << 20;  // Bytes of RAM an external search may use
+        std::string temp_directory;  // Where an external search keeps its files,
+                                     // the working directory if empty
+    };
+
     class Solver {
     public:
-        // Create a solver for the initial board passed in
-        Solver(const Board& initial);
+        class Workspace;
+
+        // Create a solver for the initial board passed in, guided by
+        // the chosen heuristic, with SolverOptions defaults otherwise
+        Solver(const Board& initial, Heuristic heuristic = Heuristic::manhattan);
+
+        // Same as above, but search with the buffers of workspace.
+        // The workspace can be handed to the next solver once this returns.
+        Solver(const Board& initial, Heuristic heuristic, Workspace& workspace);
+
+        // Create a solver with a choice of heuristic and search mode
+        Solver(const Board& initial, const SolverOptions& options);
+        Solver(const Board& initial, const SolverOptions& options, Workspace& workspace);
 
         // Is the initial board solvable?
         bool is_solvable() const;
@@ -67,32 +359,135 @@ namespace PuzzleBoard
         // Return an empty vector if the initial board is not solvable
         std::deque<Board> solution() const;
 
+        // Moves of the empty tile in a shortest solution, packed two bits each
+        MoveSequence solution_moves() const;
+
+        // Boards of a shortest solution, rebuilt only as they are visited
+        SolutionPath solution_path() const;
+
+        // Statistics of the search, see SolverStats
+        const SolverStats& statistics() const;
+
     private:
-        class Node {
-        public:
-            Board board;
-            Node* prev;
-            int moves;
-            int manhattan;
+        // The puzzle as seen by the A* engine. Boards are rebuilt by
+        // replaying moves, so a node only keeps its parent and move, and
+        // going straight back to the parent board is the only pruning.
+        struct Domain {
+            typedef Board State;
+            typedef Move Action;
+            static const bool stores_states = false;
+            static const bool detects_duplicates = false;
+
+            Heuristic heuristic;
+
+            int estimate(const Board& board) const
+            {
+                return board.heuristic(heuristic);
+            }
+
+            // Every heuristic is zero at the goal board only
+            bool is_goal(const Board&, int estimate) const
+            {
+                return estimate == 0;
+            }
 
-            Node(const Board& board, Node* prev, int moves, int manhattan)
-                : board(board), prev(prev), moves(moves), manhattan(manhattan) {}
-            bool operator<(const Node& other) const {
-                return moves + manhattan < other.moves + other.manhattan;
+            void apply(Board& board, Move move) const
+            {
+                board.move(move);
             }
-            bool operator<=(const Node& other) const {
-                return moves + manhattan <= other.moves + other.manhattan;
+
+            template <class Visitor>
+            void successors(Board& board, int estimate, const Move* last, Visitor& visit) const
+            {
+                auto child = [&](const Board& neighbour, Move move, int, int delta) {
+                    visit(neighbour, move, 1, estimate + delta);
+                };
+                if (last == nullptr) {
+                    board.for_each_neighbour(heuristic, child);
+                }
+                else {
+                    board.for_each_neighbour(heuristic, PuzzleBoard::reverse(*last), child);
+                }
             }
         };
 
+#ifdef PUZZLE_SOLVER_STATS
+        typedef HeuristicSearch::ScopedTimer Timer;
+        typedef HeuristicSearch::NodeCounter Counter;
+#else
+        typedef HeuristicSearch::NoTimer Timer;
+        typedef HeuristicSearch::NoCounter Counter;
+#endif
+        typedef HeuristicSearch::AStarEngine<Domain, Sorting::MinPriorityQueue, Timer, Counter> Engine;
+
+        // Entry of a bidirectional search frontier, ordered by MM priority
+        // max(f, 2g), then by moves made
+        struct FrontierEntry {
+            int priority;   // Larger of estimated total moves and twice the moves made
+            int moves;      // Moves made from the start of this direction
+            int estimate;   // Heuristic value
+            uint32_t node;  // Index of the node in the game tree of this direction
+
+            bool operator<(const FrontierEntry& other) const {
+                return priority < other.priority
+                    || (priority == other.priority && moves < other.moves);
+            }
+            bool operator<=(const FrontierEntry& other) const {
+                return !(other < *this);
+            }
+        };
+
+        // Node of a bidirectional game tree. A node only knows its parent by
+        // index and the move that led to it, boards are rebuilt from the root
+        // when they are needed.
+        struct TreeNode {
+            uint32_t parent;
+            Move move;  // Move of the empty tile from the parent board
+        };
+        typedef HeuristicSearch::NodePool<TreeNode> GameTree;
+
+        // Best number of moves found to a board, and its node
+        struct Visit {
+            int moves;
+            uint32_t node;
+        };
+
+        // Open set, game tree and seen boards of one search direction
+        struct Frontier {
+            Sorting::MinPriorityQueue<FrontierEntry> pq;
+            GameTree game_tree;
+            std::unordered_map<std::string, Visit> visited;  // By board key
+        };
+
+        const Board initial;
+        const Heuristic heuristic;
+        const SearchMode mode;
+        const int threads;
+        const size_t memory_limit;
+        const std::string temp_directory;
         bool solvable = false;
         int number_of_moves = -1;
-        Sorting::MinPriorityQueue<Node> pq;
-        Sorting::MinPriorityQueue<Node> pq2;
-        std::deque<Node> game_tree;
-        std::deque<Node> game_tree2;
+        std::vector<Move> moves;  // Moves of the empty tile in a shortest solution
+        Board current;            // Board of the node being expanded
+        SolverStats stats;
+
+        void solve(Workspace& workspace);
+        void bidirectional(Workspace& workspace);
+
+        // Rebuild the board of a node by replaying its moves on the start board
+        void rebuild(const GameTree& game_tree, std::vector<Move>& path,
+                     const Board& start, uint32_t node);
+    };
+
+    // Buffers of a search, which keep their capacity from one solver to the
+    // next. Give each thread its own workspace.
+    class Solver::Workspace {
+    private:
+        friend class Solver;
 
-        void a_star();
+        Solver::Engine engine;
+        std::vector<Move> path;  // Moves from the initial board to a node
+        Solver::Frontier frontiers[2];  // Forward and backward, for bidirectional search
     };
 
 #pragma endregion A* Solver
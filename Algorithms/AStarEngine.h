@@ -0,0 +1,381 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+#include <chrono>
+#include <type_traits>
+#include <stdexcept>
+#include <stdint.h>
+#include "Sorting.h"
+
+namespace HeuristicSearch
+{
+
+#pragma region A* Engine
+
+    // Adds the time spent in its scope to a counter
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(double& seconds)
+            : seconds(seconds), start(std::chrono::steady_clock::now()) {}
+        ~ScopedTimer()
+        {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            seconds += elapsed.count();
+        }
+
+        // Take the time counted by an inner timer back out of an outer one
+        static void exclude(double& seconds, double inner) { seconds -= inner; }
+
+    private:
+        double& seconds;
+        std::chrono::steady_clock::time_point start;
+    };
+
+    // Stands in for ScopedTimer when a search is not timed, and compiles
+    // away to nothing
+    struct NoTimer {
+        explicit NoTimer(double&) {}
+        static void exclude(double&, double) {}
+    };
+
+    // Nodes kept in large chunks that never move. Clearing keeps the chunks,
+    // so a pool can be reused from one search to the next.
+    template <class Node>
+    class NodePool {
+    public:
+        static const uint32_t none = 0xFFFFFFFF;  // Parent of a root
+
+        // Add a node and return its index
+        uint32_t add(const Node& node)
+        {
+            if (count == chunks.size() * chunk_size) {
+                if (count == none) {
+                    throw std::length_error("NodePool: too many nodes!");
+                }
+                chunks.emplace_back(new Node[chunk_size]);
+            }
+            (*this)[count] = node;
+            return count++;
+        }
+
+        Node& operator[](uint32_t index)
+        {
+            return chunks[index >> chunk_bits][index & (chunk_size - 1)];
+        }
+
+        const Node& operator[](uint32_t index) const
+        {
+            return chunks[index >> chunk_bits][index & (chunk_size - 1)];
+        }
+
+        // Number of nodes
+        uint32_t size() const { return count; }
+
+        // Bytes held by the chunks
+        size_t memory() const { return chunks.size() * chunk_size * sizeof(Node); }
+
+        // Remove all nodes, but keep the chunks for reuse
+        void clear() { count = 0; }
+
+    private:
+        static const int chunk_bits = 16;
+        static const uint32_t chunk_size = 1 << chunk_bits;
+
+        std::vector<std::unique_ptr<Node[]>> chunks;
+        uint32_t count = 0;
+    };
+
+    // Counters and timers of one search. Counters stay zero unless the engine
+    // is built with NodeCounter, and timers unless it is built with ScopedTimer.
+    struct EngineStats {
+        uint64_t nodes_generated = 0;
+        uint64_t nodes_expanded = 0;
+        uint64_t duplicates_pruned = 0;  // Children no cheaper than a known path
+        size_t peak_open_set = 0;
+        size_t peak_node_memory = 0;     // Bytes of nodes and open set
+        double heuristic_seconds = 0.0;  // Generating successors and their estimates
+        double heap_seconds = 0.0;       // Pushing to and popping from the open set
+        double neighbour_seconds = 0.0;  // Restoring states and adding nodes
+    };
+
+    // Counts the nodes of a search and the peak size of its open set and
+    // nodes into EngineStats
+    class NodeCounter {
+    public:
+        explicit NodeCounter(EngineStats& stats) : stats(stats) {}
+
+        void generated() { ++stats.nodes_generated; }
+        void expanded() { ++stats.nodes_expanded; }
+        void pruned() { ++stats.duplicates_pruned; }
+
+        // Take the sizes after an expansion
+        template <class Open, class Pool>
+        void sample(const Open& open, const Pool& nodes, size_t entry_size)
+        {
+            stats.peak_open_set = std::max(stats.peak_open_set, static_cast<size_t>(open.size()));
+            stats.peak_node_memory = std::max(stats.peak_node_memory,
+                                              nodes.memory() + open.size() * entry_size);
+        }
+
+    private:
+        EngineStats& stats;
+    };
+
+    // Stands in for NodeCounter when a search is not counted, and compiles
+    // away to nothing
+    struct NoCounter {
+        explicit NoCounter(EngineStats&) {}
+        void generated() {}
+        void expanded() {}
+        void pruned() {}
+
+        template <class Open, class Pool>
+        void sample(const Open&, const Pool&, size_t) {}
+    };
+
+    namespace Detail
+    {
+        // State kept in a node, or nothing if states are rebuilt
+        template <class State, bool stored>
+        struct NodeState {
+            State state;
+        };
+
+        template <class State>
+        struct NodeState<State, false> {
+        };
+
+        // Cheapest known cost of every state, or nothing if the domain does
+        // not look for duplicates
+        template <class Domain, bool detected>
+        class SeenStates {
+        public:
+            void clear() { best.clear(); }
+
+            // Record a path of this cost, return false if it is no cheaper
+            // than a known one
+            bool improves(const Domain& domain, const typename Domain::State& state, int cost)
+            {
+                auto result = best.emplace(domain.key(state), cost);
+                if (!result.second) {
+                    if (result.first->second <= cost) {
+                        return false;
+                    }
+                    result.first->second = cost;
+                }
+                return true;
+            }
+
+            // Has a cheaper path been found since the state was queued?
+            bool is_stale(const Domain& domain, const typename Domain::State& state, int cost) const
+            {
+                return best.at(domain.key(state)) < cost;
+            }
+
+        private:
+            std::unordered_map<typename Domain::Key, int, typename Domain::Hash> best;
+        };
+
+        template <class Domain>
+        class SeenStates<Domain, false> {
+        public:
+            void clear() {}
+            bool improves(const Domain&, const typename Domain::State&, int) { return true; }
+            bool is_stale(const Domain&, const typename Domain::State&, int) const { return false; }
+        };
+    }
+
+    // A* over any domain that describes its search space at compile time,
+    // so the inner loop makes no virtual calls. A domain provides:
+    //
+    //   typedef ... State;   // Copyable, and default constructible if stored
+    //   typedef ... Action;  // Small value that leads from a state to a successor
+    //   static const bool stores_states;       // Keep the state in every node,
+    //                                          // rather than replaying actions
+    //   static const bool detects_duplicates;  // Drop paths no cheaper than a known one,
+    //   typedef ... Key;                       // which needs a key of each state
+    //   typedef ... Hash;                      // and a hash function of keys
+    //   Key key(const State& state) const;
+    //
+    //   int estimate(const State& state) const;  // Admissible heuristic
+    //   bool is_goal(const State& state, int estimate) const;
+    //   void apply(State& state, Action action) const;
+    //
+    //   // Call visit(successor, action, cost, estimate) for each successor.
+    //   // last is the action that led to state, nullptr at the start.
+    //   // state may be changed while visiting, but must be restored.
+    //   template <class Visitor>
+    //   void successors(State& state, int estimate, const Action* last, Visitor& visit) const;
+    //
+    // Queue is the open set, with push, pop_min, is_empty, size and clear.
+    // Timer and Counter fill the statistics, and by default leave them zero
+    // at no cost.
+    // The engine keeps its buffers between searches, so reuse one engine
+    // rather than creating one for every search.
+    template <class Domain,
+              template <class> class Queue = Sorting::MinPriorityQueue,
+              class Timer = NoTimer,
+              class Counter = NoCounter>
+    class AStarEngine {
+    public:
+        typedef typename Domain::State State;
+        typedef typename Domain::Action Action;
+
+        // Entry of the open set, ordered by estimated total cost and then
+        // by cost so far, so deeper nodes are expanded first on ties
+        struct Entry {
+            int priority;  // Cost so far plus estimate
+            int cost;      // Cost from the start
+            uint32_t node;
+
+            bool operator<(const Entry& other) const {
+                return priority < other.priority
+                    || (priority == other.priority && cost > other.cost);
+            }
+            bool operator<=(const Entry& other) const {
+                return !(other < *this);
+            }
+        };
+
+        struct Node : Detail::NodeState<State, Domain::stores_states> {
+            uint32_t parent;
+            Action action;  // Action that led here from the parent
+        };
+
+        // Search for a cheapest path from start to a goal. Fill actions with
+        // the path and return its cost, or return -1 if there is none.
+        int search(const Domain& domain, const State& start, std::vector<Action>& actions,
+                   EngineStats& stats)
+        {
+            typedef std::integral_constant<bool, Domain::stores_states> Stored;
+            Counter counter(stats);
+
+            open.clear();
+            nodes.clear();
+            seen.clear();
+            actions.clear();
+
+            if (!current) {
+                current.reset(new State(start));
+            }
+            int start_estimate = domain.estimate(start);
+            uint32_t root = add(Node(), NodePool<Node>::none, Action(), start, Stored());
+            seen.improves(domain, start, 0);
+            open.push(Entry{ start_estimate, 0, root });
+            counter.generated();
+
+            while (!open.is_empty()) {
+                Entry entry;
+                {
+                    Timer timer(stats.heap_seconds);
+                    entry = open.pop_min();
+                }
+                {
+                    Timer timer(stats.neighbour_seconds);
+                    restore(domain, start, entry.node, Stored());
+                }
+                if (seen.is_stale(domain, *current, entry.cost)) {
+                    continue;
+                }
+
+                int estimate = entry.priority - entry.cost;
+                if (domain.is_goal(*current, estimate)) {
+                    for (uint32_t i = entry.node; nodes[i].parent != NodePool<Node>::none; i = nodes[i].parent) {
+                        actions.push_back(nodes[i].action);
+                    }
+                    std::reverse(actions.begin(), actions.end());
+                    return entry.cost;
+                }
+                counter.expanded();
+
+                Action last = nodes[entry.node].action;
+                bool has_parent = nodes[entry.node].parent != NodePool<Node>::none;
+
+                double visit_seconds = 0.0;
+                auto visit = [&](const State& successor, Action action, int cost, int successor_estimate) {
+                    Timer visit_timer(visit_seconds);
+                    int successor_cost = entry.cost + cost;
+                    if (!seen.improves(domain, successor, successor_cost)) {
+                        counter.pruned();
+                        return;
+                    }
+
+                    uint32_t child;
+                    {
+                        Timer timer(stats.neighbour_seconds);
+                        child = add(Node(), entry.node, action, successor, Stored());
+                    }
+                    {
+                        Timer timer(stats.heap_seconds);
+                        open.push(Entry{ successor_cost + successor_estimate, successor_cost, child });
+                    }
+                    counter.generated();
+                };
+
+                {
+                    Timer timer(stats.heuristic_seconds);
+                    domain.successors(*current, estimate, has_parent ? &last : nullptr, visit);
+                }
+                // Time outside the visitor went to the domain itself
+                Timer::exclude(stats.heuristic_seconds, visit_seconds);
+                counter.sample(open, nodes, sizeof(Entry));
+            }
+
+            return -1;
+        }
+
+        int search(const Domain& domain, const State& start, std::vector<Action>& actions)
+        {
+            EngineStats stats;
+            return search(domain, start, actions, stats);
+        }
+
+    private:
+        Queue<Entry> open;
+        NodePool<Node> nodes;
+        Detail::SeenStates<Domain, Domain::detects_duplicates> seen;
+        std::vector<Action> path;        // Actions from the start to a node
+        std::unique_ptr<State> current;  // State of the node being expanded
+
+        uint32_t add(Node node, uint32_t parent, Action action, const State& state, std::true_type)
+        {
+            node.parent = parent;
+            node.action = action;
+            node.state = state;
+            return nodes.add(node);
+        }
+
+        uint32_t add(Node node, uint32_t parent, Action action, const State&, std::false_type)
+        {
+            node.parent = parent;
+            node.action = action;
+            return nodes.add(node);
+        }
+
+        void restore(const Domain&, const State&, uint32_t node, std::true_type)
+        {
+            *current = nodes[node].state;
+        }
+
+        // Rebuild the state of a node by replaying its actions on the start.
+        // Assigning keeps any buffers of the current state.
+        void restore(const Domain& domain, const State& start, uint32_t node, std::false_type)
+        {
+            path.clear();
+            for (uint32_t i = node; nodes[i].parent != NodePool<Node>::none; i = nodes[i].parent) {
+                path.push_back(nodes[i].action);
+            }
+
+            *current = start;
+            for (auto action = path.rbegin(); action != path.rend(); ++action) {
+                domain.apply(*current, *action);
+            }
+        }
+    };
+
+#pragma endregion A* Engine
+
+}
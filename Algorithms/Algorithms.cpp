@@ -8,6 +8,8 @@
 #include "UnionFind.h"
 #include "Sorting.h"
 #include "AStar.h"
+#include "PuzzleBatch.h"
+#include "AnytimeAStar.h"
 
 using namespace std;
 using namespace UnionFind;
@@ -22,7 +24,11 @@ int main()
     
     cout << "Testing percolation...\n\n";
     try {
-        PercolationStats p(100, 40);
+        // Trials are seeded from one master seed, so the stats are the
+        // same on any number of threads
+        PercolationOptions options;
+        options.threads = 0;
+        PercolationStats p(100, 40, options);
 
     }
     catch (const invalid_argument & e) {
@@ -43,6 +49,28 @@ int main()
 #pragma endregion Percolation
 
 
+#pragma region Newman-Ziff
+
+    cout << "\n\nTesting Newman-Ziff percolation...\n\n";
+    {
+        NewmanZiff sweeper(256);
+        mt19937_64 sweep_generator(2020);
+        double threshold_sum = 0.0;
+        for (int i = 0; i < 10; ++i) {
+            threshold_sum += sweeper.sweep(sweep_generator);
+        }
+        cout << "Mean threshold of " << sweeper.number_of_sweeps() << " sweeps on a 256x256 grid: "
+             << threshold_sum / sweeper.number_of_sweeps() << "\n\n";
+
+        cout << "p      percolating  largest cluster\n";
+        for (const PercolationPoint& point : sweeper.curve(11)) {
+            cout << point.probability << '\t' << point.percolating << '\t' << point.largest_cluster << '\n';
+        }
+    }
+
+#pragma endregion Newman-Ziff
+
+
 #pragma region Minimum Priority Queue
 
     cout << "\n\nTesting minimum priority queue...\n\n";
@@ -73,12 +101,67 @@ int main()
     Solver solver(initial);
     cout << "Solvable: " << boolalpha << solver.is_solvable() << '\n';
     cout << "Min moves: " << solver.min_moves() << '\n';
+#ifdef PUZZLE_SOLVER_STATS
+    const SolverStats& stats = solver.statistics();
+    cout << "Nodes expanded: " << stats.nodes_expanded << '\n';
+    cout << "Nodes generated: " << stats.nodes_generated << '\n';
+    cout << "Peak open set: " << stats.peak_open_set << '\n';
+    cout << "Search time: " << stats.search_seconds << "s\n";
+#endif
+    cout << "Solution moves: " << solver.solution_moves().to_string() << '\n';
     cout << "\nSolution sequence:\n\n";
-    auto solution = solver.solution();
-    for (Board elem : solution) {
+    for (const Board& elem : solver.solution_path()) {
         cout << elem.string_representation() << '\n';
     }
 
 #pragma endregion A*
 
+
+#pragma region Batch A*
+
+    cout << "\nTesting batch solver on random 3x3 boards...\n\n";
+    vector<Board> boards;
+    vector<int> batch_tiles = { 1, 2, 3, 4, 5, 6, 7, 8, 0 };
+    mt19937 batch_generator(2020);
+    for (int i = 0; i < 200; ++i) {
+        shuffle(batch_tiles.begin(), batch_tiles.end(), batch_generator);
+        boards.push_back(Board(batch_tiles));
+    }
+    SolverOptions batch_options;
+    batch_options.heuristic = Heuristic::linear_conflict;
+    BatchSolver batch(batch_options);
+    auto results = batch.solve(boards, [](const BatchResult&, const BatchProgress& progress) {
+        if (progress.finished % 50 == 0) {
+            cout << progress.finished << " of " << progress.total << " boards solved, "
+                 << progress.puzzles_per_second << " puzzles/s\n";
+        }
+    });
+    int solvable_count = 0;
+    for (const BatchResult& result : results) {
+        solvable_count += result.solvable;
+    }
+    cout << solvable_count << " boards were solvable\n";
+
+#pragma endregion Batch A*
+
+
+#pragma region Anytime A*
+
+    cout << "\nTesting anytime A* solver...\n\n";
+    int anytime_arr[] = { 5, 1, 3, 4, 2, 0, 7, 8, 9, 6, 10, 12, 13, 14, 11, 15 };
+    vector<int> anytime_tiles(anytime_arr, anytime_arr + sizeof(anytime_arr) / sizeof(int));
+    AnytimeOptions anytime_options;
+    anytime_options.heuristic = Heuristic::linear_conflict;
+    AnytimeSolver anytime(Board(anytime_tiles), anytime_options);
+    bool optimal = false;
+    while (!optimal) {
+        optimal = anytime.search(0, 20);
+        if (anytime.has_solution()) {
+            cout << "Moves: " << anytime.min_moves() << ", within "
+                 << anytime.suboptimality_bound() << " times the minimum\n";
+        }
+    }
+
+#pragma endregion Anytime A*
+
 }
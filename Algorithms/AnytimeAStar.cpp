@@ -0,0 +1,248 @@
+#include <stdexcept>
+#include <chrono>
+#include <algorithm>
+#include <climits>
+#include <limits>
+#include "AnytimeAStar.h"
+
+using namespace std;
+using namespace PuzzleBoard;
+
+
+#pragma region Anytime A*
+
+AnytimeSolver::AnytimeSolver(const Board& initial, const AnytimeOptions& options)
+    : initial(initial), options(options), current_weight(options.initial_weight),
+      proven_weight(numeric_limits<double>::infinity()), lower_bound(0)
+{
+    if (options.initial_weight < 1.0 || options.weight_step <= 0.0) {
+        throw invalid_argument("AnytimeSolver: weight should be at least 1 and step positive!");
+    }
+
+    solvable = initial.is_solvable();
+    if (!solvable) {
+        return;
+    }
+
+    auto root = states.emplace(initial.key(), State{ 0, initial.heuristic(options.heuristic), nullptr, Move::up });
+    lower_bound = root.first->second.estimate;
+    if (lower_bound == 0) {
+        goal = &root.first->second;
+        optimal = true;
+        return;
+    }
+    push(*root.first);
+}
+
+bool AnytimeSolver::search(double seconds, uint64_t nodes)
+{
+    if (!solvable || optimal) {
+        return optimal;
+    }
+
+    auto start = chrono::steady_clock::now();
+    uint64_t expanded = 0;
+
+    while (true) {
+        // Improve the path until no open state can beat the solution
+        while (!open.is_empty()) {
+            Entry entry = open.min();
+            if (goal != nullptr && entry.priority >= goal->moves) {
+                break;
+            }
+
+            if (nodes > 0 && expanded >= nodes) {
+                return false;
+            }
+            if (seconds > 0 && expanded % 64 == 0) {
+                chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+                if (elapsed.count() >= seconds) {
+                    return false;
+                }
+            }
+
+            open.pop_min();
+            State& state = entry.state->second;
+            if (entry.moves != state.moves || state.closed == iteration) {
+                continue;
+            }
+            expand(*entry.state);
+            ++expanded;
+            SOLVER_STATS(stats.peak_open_set = max(stats.peak_open_set, static_cast<size_t>(open.size())));
+            // A hash node holds a state, its key and a link, and every bucket a link
+            SOLVER_STATS(stats.peak_node_memory = max(stats.peak_node_memory,
+                states.size() * (sizeof(StateMap::value_type) + entry.state->first.size() + 2 * sizeof(void*))
+                + states.bucket_count() * sizeof(void*) + open.size() * sizeof(Entry)));
+        }
+
+        finish_search();
+        if (optimal) {
+            return true;
+        }
+    }
+}
+
+void AnytimeSolver::expand(StateMap::value_type& state)
+{
+    State& parent = state.second;
+    parent.closed = iteration;
+    Board board = Board::from_key(state.first);
+    SOLVER_STATS(++stats.nodes_expanded);
+
+    auto visit = [&](const Board& neighbour, Move move, int, int delta) {
+        int moves = parent.moves + 1;
+        SOLVER_STATS(++stats.nodes_generated);
+        auto result = states.emplace(neighbour.key(), State{ moves, parent.estimate + delta, &parent, move });
+        State& child = result.first->second;
+        if (!result.second) {
+            if (child.moves <= moves) {
+                SOLVER_STATS(++stats.duplicates_pruned);
+                return;
+            }
+            child.moves = moves;
+            child.parent = &parent;
+            child.move = move;
+        }
+
+        // Every heuristic is zero at the goal board only
+        if (child.estimate == 0) {
+            goal = &child;
+        }
+        else if (child.closed == iteration) {
+            // Expanded already in this search, wait for the next one
+            if (!child.inconsistent) {
+                child.inconsistent = true;
+                inconsistent.push_back(&*result.first);
+            }
+        }
+        else {
+            push(*result.first);
+        }
+    };
+
+    if (parent.parent == nullptr) {
+        board.for_each_neighbour(options.heuristic, visit);
+    }
+    else {
+        board.for_each_neighbour(options.heuristic, PuzzleBoard::reverse(parent.move), visit);
+    }
+}
+
+void AnytimeSolver::push(StateMap::value_type& state)
+{
+    const State& s = state.second;
+    open.push(Entry{ s.moves + current_weight * s.estimate, s.moves, &state });
+}
+
+void AnytimeSolver::finish_search()
+{
+    // Open and inconsistent states bound the moves of any better solution
+    vector<StateMap::value_type*> pending;
+    while (!open.is_empty()) {
+        Entry entry = open.pop_min();
+        State& state = entry.state->second;
+        if (entry.moves == state.moves && state.closed != iteration && !state.inconsistent) {
+            state.inconsistent = true;  // Marks it as pending for now
+            pending.push_back(entry.state);
+        }
+    }
+    pending.insert(pending.end(), inconsistent.begin(), inconsistent.end());
+    inconsistent.clear();
+
+    int lower = INT_MAX;
+    for (auto state : pending) {
+        state->second.inconsistent = false;
+        lower = min(lower, state->second.moves + state->second.estimate);
+    }
+    lower_bound = max(lower_bound, lower);
+    proven_weight = current_weight;
+
+    if (current_weight <= 1.0 || goal->moves <= lower_bound) {
+        optimal = true;
+        return;
+    }
+
+    // The next search starts from every state that isn't settled yet
+    current_weight = max(1.0, current_weight - options.weight_step);
+    ++iteration;
+    for (auto state : pending) {
+        push(*state);
+    }
+}
+
+vector<Move> AnytimeSolver::solution_moves() const
+{
+    vector<Move> moves;
+    if (goal != nullptr) {
+        for (const State* state = goal; state->parent != nullptr; state = state->parent) {
+            moves.push_back(state->move);
+        }
+        reverse(moves.begin(), moves.end());
+    }
+
+    return moves;
+}
+
+bool AnytimeSolver::is_solvable() const
+{
+    return solvable;
+}
+
+bool AnytimeSolver::has_solution() const
+{
+    return goal != nullptr;
+}
+
+int AnytimeSolver::min_moves() const
+{
+    return has_solution() ? static_cast<int>(solution_moves().size()) : -1;
+}
+
+double AnytimeSolver::suboptimality_bound() const
+{
+    if (!has_solution()) {
+        return numeric_limits<double>::infinity();
+    }
+    if (optimal) {
+        return 1.0;
+    }
+
+    // A solution found while a search is still running is at least as good
+    // as the one that search started with
+    double ratio = lower_bound > 0 ? static_cast<double>(min_moves()) / lower_bound
+                                   : numeric_limits<double>::infinity();
+    return max(1.0, min(proven_weight, ratio));
+}
+
+bool AnytimeSolver::is_optimal() const
+{
+    return optimal;
+}
+
+double AnytimeSolver::weight() const
+{
+    return current_weight;
+}
+
+deque<Board> AnytimeSolver::solution() const
+{
+    deque<Board> solution_boards;
+
+    if (has_solution()) {
+        Board board = initial;
+        solution_boards.push_back(board);
+        for (Move move : solution_moves()) {
+            board.move(move);
+            solution_boards.push_back(board);
+        }
+    }
+
+    return solution_boards;
+}
+
+const SolverStats& AnytimeSolver::statistics() const
+{
+    return stats;
+}
+
+#pragma endregion Anytime A*
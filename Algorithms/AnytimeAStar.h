@@ -0,0 +1,114 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <stdint.h>
+#include "AStar.h"
+
+namespace PuzzleBoard
+{
+
+#pragma region Anytime A*
+
+    struct AnytimeOptions {
+        Heuristic heuristic = Heuristic::manhattan;
+        double initial_weight = 3.0;  // Heuristic weight of the first search
+        double weight_step = 0.5;     // Weight taken off after each solution
+    };
+
+    // Anytime repairing A* (ARA*). The first search inflates the heuristic to
+    // find some solution fast. Every later search lowers the weight and
+    // reuses the work done so far to find a better one, until the weight
+    // reaches 1 and the solution is proven optimal.
+    // Call search() with a budget as often as needed, and ask for the best
+    // solution so far in between.
+    class AnytimeSolver {
+    public:
+        AnytimeSolver(const Board& initial, const AnytimeOptions& options = AnytimeOptions());
+
+        // Keep searching until the solution is optimal, or until seconds of
+        // time or expanded nodes run out. A budget of 0 means no limit.
+        // Return true if the solution is optimal.
+        bool search(double seconds, uint64_t nodes = 0);
+
+        // Is the initial board solvable?
+        bool is_solvable() const;
+
+        // Has any solution been found yet?
+        bool has_solution() const;
+
+        // Number of moves of the best solution so far, -1 if there is none
+        int min_moves() const;
+
+        // The best solution so far takes at most this many times the
+        // minimum number of moves
+        double suboptimality_bound() const;
+
+        bool is_optimal() const;
+
+        // Heuristic weight of the current search
+        double weight() const;
+
+        // Sequence of boards in the best solution so far
+        std::deque<Board> solution() const;
+
+        // Statistics of every search so far, see SolverStats. Only the node
+        // counters, the peak open set and the peak memory are filled.
+        const SolverStats& statistics() const;
+
+    private:
+        struct State {
+            int moves;
+            int estimate;
+            const State* parent;
+            Move move;           // Move of the empty tile from the parent board
+            int closed = -1;     // Search in which the state was expanded
+            bool inconsistent = false;
+        };
+        typedef std::unordered_map<std::string, State> StateMap;
+
+        struct Entry {
+            double priority;  // Moves plus weighted heuristic value
+            int moves;
+            StateMap::value_type* state;
+
+            bool operator<(const Entry& other) const {
+                return priority < other.priority
+                    || (priority == other.priority && moves > other.moves);
+            }
+            bool operator<=(const Entry& other) const {
+                return !(other < *this);
+            }
+        };
+
+        const Board initial;
+        const AnytimeOptions options;
+        bool solvable = false;
+        bool optimal = false;
+        double current_weight;
+        double proven_weight;  // Weight of the last finished search
+        int lower_bound;       // No solution takes fewer moves
+        int iteration = 0;
+
+        StateMap states;
+        Sorting::MinPriorityQueue<Entry> open;
+        std::vector<StateMap::value_type*> inconsistent;  // Improved after being expanded
+        const State* goal = nullptr;
+        SolverStats stats;
+
+        void expand(StateMap::value_type& state);
+        void push(StateMap::value_type& state);
+
+        // Raise the lower bound from the states left by a finished search,
+        // and prepare the next search with a lower weight
+        void finish_search();
+
+        // Moves of the empty tile in the best solution so far
+        std::vector<Move> solution_moves() const;
+    };
+
+#pragma endregion Anytime A*
+
+}
@@ -0,0 +1,434 @@
+#include <stdexcept>
+#include <fstream>
+#include <string>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <string.h>
+
+#include "EdgeList.h"
+
+using namespace UnionFind;
+using namespace std;
+
+
+#pragma region Edge List Components
+
+namespace
+{
+    size_t record_size(EdgeFormat format)
+    {
+        switch (format) {
+        case EdgeFormat::binary32:
+            return 2 * sizeof(uint32_t);
+        case EdgeFormat::binary64:
+            return 2 * sizeof(uint64_t);
+        default:
+            return 0;
+        }
+    }
+
+    bool is_separator(char c)
+    {
+        return c == ' ' || c == '\t' || c == ',' || c == '\r';
+    }
+
+    // Parse a node id at p, moving p past it
+    int64_t parse_node(const char*& p, const char* end)
+    {
+        if (p == end || *p < '0' || *p > '9') {
+            throw invalid_argument("EdgeListComponents: a line should start with two node ids!");
+        }
+        uint64_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value = value * 10 + static_cast<uint64_t>(*p - '0');
+            ++p;
+        }
+        return static_cast<int64_t>(value);
+    }
+
+    // Parse the lines from begin to end, which ends at the end of a line
+    void parse_text(const char* begin, const char* end, vector<NodePair>& pairs)
+    {
+        const char* p = begin;
+        while (p < end) {
+            const char* line_end = static_cast<const char*>(memchr(p, '\n', end - p));
+            if (!line_end) {
+                line_end = end;
+            }
+
+            while (p < line_end && is_separator(*p)) {
+                ++p;
+            }
+            if (p < line_end && *p != '#' && *p != '%') {
+                NodePair pair;
+                pair.a = parse_node(p, line_end);
+                while (p < line_end && is_separator(*p)) {
+                    ++p;
+                }
+                pair.b = parse_node(p, line_end);
+                pairs.push_back(pair);  // Anything after the two ids, like a weight, is ignored
+            }
+
+            p = line_end + 1;
+        }
+    }
+
+    // Node ids are stored little-endian, the byte order of every platform
+    // this builds for, so they are copied as they are
+    template <class Id>
+    void parse_binary(const char* begin, const char* end, vector<NodePair>& pairs)
+    {
+        for (const char* p = begin; p < end; p += 2 * sizeof(Id)) {
+            Id ids[2];
+            memcpy(ids, p, sizeof(ids));
+            pairs.push_back(NodePair{ static_cast<int64_t>(ids[0]), static_cast<int64_t>(ids[1]) });
+        }
+    }
+
+    // Threads that run work(t) once per round, each with its own t. They
+    // are started once and wait between rounds, so the caller can start a
+    // round, do something else and wait for it, as often as it needs.
+    class Workers {
+    public:
+        Workers(int count, function<void(int)> work) : work(work)
+        {
+            for (int t = 0; t < count; ++t) {
+                threads.emplace_back(&Workers::loop, this, t);
+            }
+        }
+
+        ~Workers()
+        {
+            {
+                lock_guard<mutex> lock(state_mutex);
+                stopping = true;
+            }
+            started.notify_all();
+            for (thread& worker : threads) {
+                worker.join();
+            }
+        }
+
+        void start()
+        {
+            {
+                lock_guard<mutex> lock(state_mutex);
+                ++round;
+                running = static_cast<int>(threads.size());
+            }
+            started.notify_all();
+        }
+
+        // Wait for the round to end, and rethrow the first error it had
+        void wait()
+        {
+            unique_lock<mutex> lock(state_mutex);
+            finished.wait(lock, [this] { return running == 0; });
+            if (error) {
+                exception_ptr first = error;
+                error = nullptr;
+                rethrow_exception(first);
+            }
+        }
+
+    private:
+        function<void(int)> work;
+        vector<thread> threads;
+        mutex state_mutex;
+        condition_variable started, finished;
+        uint64_t round = 0;
+        int running = 0;
+        bool stopping = false;
+        exception_ptr error;
+
+        void loop(int t)
+        {
+            uint64_t done = 0;
+            while (true) {
+                {
+                    unique_lock<mutex> lock(state_mutex);
+                    started.wait(lock, [&] { return stopping || round != done; });
+                    if (stopping) {
+                        return;
+                    }
+                    done = round;
+                }
+
+                exception_ptr failure;
+                try {
+                    work(t);
+                }
+                catch (...) {
+                    failure = current_exception();
+                }
+
+                lock_guard<mutex> lock(state_mutex);
+                if (failure && !error) {
+                    error = failure;
+                }
+                if (--running == 0) {
+                    finished.notify_one();
+                }
+            }
+        }
+    };
+
+    // Read the edges of a file and call visit(pairs) with each batch of
+    // parsed edges, from threads threads at once. The threads are started
+    // once, and while they parse one buffer, the next one is read into the
+    // other.
+    // Return the number of edges.
+    template <class Visit>
+    int64_t scan(const string& file_name, const EdgeListOptions& options, int threads, Visit visit)
+    {
+        ifstream in(file_name, ios::binary);
+        if (!in) {
+            throw invalid_argument("EdgeListComponents: cannot read " + file_name + "!");
+        }
+
+        const size_t record = record_size(options.format);
+        vector<char> buffer(options.buffer_size), other(options.buffer_size);
+        vector<vector<NodePair>> batches(threads);  // Kept from buffer to buffer
+        vector<const char*> bounds(threads + 1);    // Slice of each thread
+        atomic<int64_t> edges(0);
+
+        Workers workers(threads, [&](int t) {
+            vector<NodePair>& pairs = batches[t];
+            pairs.clear();
+            if (record == 0) {
+                parse_text(bounds[t], bounds[t + 1], pairs);
+            }
+            else if (options.format == EdgeFormat::binary32) {
+                parse_binary<uint32_t>(bounds[t], bounds[t + 1], pairs);
+            }
+            else {
+                parse_binary<uint64_t>(bounds[t], bounds[t + 1], pairs);
+            }
+            visit(pairs);
+            edges += static_cast<int64_t>(pairs.size());
+        });
+
+        auto read = [&in](vector<char>& into, size_t offset) {
+            in.read(into.data() + offset, into.size() - offset);
+            return offset + static_cast<size_t>(in.gcount());
+        };
+
+        size_t size = read(buffer, 0);
+        while (size > 0) {
+            bool at_end = size < buffer.size() || in.peek() == char_traits<char>::eof();
+
+            // Cut after the last whole line or record, and carry the rest over
+            size_t cut = size;
+            if (record > 0) {
+                cut -= size % record;
+                if (at_end && cut != size) {
+                    throw invalid_argument("EdgeListComponents: " + file_name + " ends in a partial edge!");
+                }
+            }
+            else if (!at_end) {
+                const char* p = buffer.data() + size;
+                while (p > buffer.data() && p[-1] != '\n') {
+                    --p;
+                }
+                cut = p - buffer.data();
+                if (cut == 0) {
+                    throw invalid_argument("EdgeListComponents: a line is longer than the buffer!");
+                }
+            }
+
+            // Slice the buffer between the threads, at line or record ends
+            bounds[0] = buffer.data();
+            bounds[threads] = buffer.data() + cut;
+            for (int t = 1; t < threads; ++t) {
+                size_t at = cut / threads * t;
+                if (record > 0) {
+                    at -= at % record;
+                }
+                const char* p = max<const char*>(buffer.data() + at, bounds[t - 1]);
+                if (record == 0) {
+                    while (p < bounds[threads] && p > buffer.data() && p[-1] != '\n') {
+                        ++p;
+                    }
+                }
+                bounds[t] = p;
+            }
+
+            workers.start();
+            size_t carried = size - cut;
+            memcpy(other.data(), buffer.data() + cut, carried);
+            size_t next_size = at_end ? carried : read(other, carried);
+            workers.wait();
+
+            swap(buffer, other);
+            size = next_size;
+        }
+
+        return edges;
+    }
+
+    // Write text through a large buffer of our own
+    class LineWriter {
+    public:
+        explicit LineWriter(const string& file_name) : out(file_name, ios::binary)
+        {
+            if (!out) {
+                throw invalid_argument("EdgeListComponents: cannot write " + file_name + "!");
+            }
+            text.reserve(capacity);
+        }
+
+        void number(int64_t value)
+        {
+            char digits[24];
+            int count = 0;
+            uint64_t rest = static_cast<uint64_t>(value);
+            do {
+                digits[count++] = static_cast<char>('0' + rest % 10);
+                rest /= 10;
+            } while (rest > 0);
+            while (count > 0) {
+                text.push_back(digits[--count]);
+            }
+        }
+
+        void put(char c)
+        {
+            text.push_back(c);
+            if (text.size() >= capacity) {
+                flush();
+            }
+        }
+
+        void flush()
+        {
+            out.write(text.data(), text.size());
+            text.clear();
+            if (!out) {
+                throw runtime_error("EdgeListComponents: writing failed!");
+            }
+        }
+
+    private:
+        static const size_t capacity = 1 << 20;
+        ofstream out;
+        string text;
+    };
+}
+
+EdgeListComponents::EdgeListComponents(const EdgeListOptions& options)
+    : options(options),
+      threads(options.threads > 0 ? options.threads : max(1, static_cast<int>(thread::hardware_concurrency()))),
+      nodes(options.nodes)
+{
+    if (options.nodes < 0) {
+        throw invalid_argument("EdgeListComponents: nodes should not be negative!");
+    }
+    if (options.threads < 0) {
+        throw invalid_argument("EdgeListComponents: threads should not be negative!");
+    }
+    if (options.buffer_size < 4096) {
+        throw invalid_argument("EdgeListComponents: buffer size should be at least 4 KiB!");
+    }
+
+    if (nodes > 0) {
+        grid.reset(new ConcurrentUnionFind(nodes));
+    }
+}
+
+void EdgeListComponents::read(const string& file_name)
+{
+    // Without a node count, the largest id sets it
+    if (!grid) {
+        atomic<int64_t> largest(-1);
+        scan(file_name, options, threads, [&largest](const vector<NodePair>& pairs) {
+            int64_t local = -1;
+            for (const NodePair& pair : pairs) {
+                local = max(local, max(pair.a, pair.b));
+            }
+            int64_t seen = largest.load();
+            while (local > seen && !largest.compare_exchange_weak(seen, local)) {
+            }
+        });
+        if (largest < 0) {
+            throw invalid_argument("EdgeListComponents: " + file_name + " has no edges to count nodes from!");
+        }
+        nodes = largest + 1;
+        grid.reset(new ConcurrentUnionFind(nodes));
+    }
+
+    ConcurrentUnionFind& uf = *grid;
+    edges += scan(file_name, options, threads, [&uf](const vector<NodePair>& pairs) {
+        for (const NodePair& pair : pairs) {
+            uf.connect(pair.a, pair.b);
+        }
+    });
+}
+
+int64_t EdgeListComponents::number_of_nodes() const
+{
+    return nodes;
+}
+
+int64_t EdgeListComponents::number_of_edges() const
+{
+    return edges;
+}
+
+int64_t EdgeListComponents::number_of_components() const
+{
+    return grid ? grid->count() : 0;
+}
+
+FrozenConnectivity EdgeListComponents::components()
+{
+    if (!grid) {
+        throw invalid_argument("EdgeListComponents: no edges read yet!");
+    }
+
+    return grid->freeze();
+}
+
+void EdgeListComponents::write_labels(const string& file_name)
+{
+    FrozenConnectivity frozen = components();
+    LineWriter out(file_name);
+    for (int64_t label : frozen.labels()) {
+        out.number(label);
+        out.put('\n');
+    }
+    out.flush();
+}
+
+void EdgeListComponents::write_histogram(const string& file_name)
+{
+    FrozenConnectivity frozen = components();
+
+    // Labels follow first nodes, so a component is new when its label is
+    // the next one
+    map<int64_t, int64_t> histogram;
+    int64_t next_label = 0;
+    const vector<int64_t>& labels = frozen.labels();
+    for (int64_t i = 0; i < frozen.size(); ++i) {
+        if (labels[i] == next_label) {
+            ++histogram[frozen.component_size(i)];
+            ++next_label;
+        }
+    }
+
+    LineWriter out(file_name);
+    for (const auto& bar : histogram) {
+        out.number(bar.first);
+        out.put(' ');
+        out.number(bar.second);
+        out.put('\n');
+    }
+    out.flush();
+}
+
+#pragma endregion Edge List Components
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdint.h>
+#include "UnionFind.h"
+
+namespace UnionFind
+{
+
+#pragma region Edge List Components
+
+    // Layout of an edge file
+    enum class EdgeFormat {
+        text,      // Two node ids per line, lines starting with # or % skipped
+        binary32,  // Pairs of little-endian 32-bit node ids
+        binary64,  // Pairs of little-endian 64-bit node ids
+    };
+
+    struct EdgeListOptions {
+        EdgeFormat format = EdgeFormat::text;
+        int64_t nodes = 0;  // Node ids are within [0, nodes - 1], or 0 to find them in a first pass
+        int threads = 0;    // 0 for one per hardware thread
+        size_t buffer_size = size_t(64) << 20;  // Bytes read at a time, two buffers are kept
+    };
+
+    // Connected components of graphs too large to hold, read from edge
+    // files. Files are read a buffer at a time, and while one buffer is
+    // read the threads parse the other, each its own slice, and connect
+    // the edges they parsed in a shared ConcurrentUnionFind. Memory depends
+    // on the number of nodes and the buffer size, never on the number of
+    // edges. The union-find cannot grow while threads connect nodes, so
+    // without options.nodes the first file is read twice, once to find the
+    // largest node id. Give the node count when it is known to read it once.
+    class EdgeListComponents {
+    public:
+        EdgeListComponents(const EdgeListOptions& options = EdgeListOptions());
+
+        // Connect the nodes of every edge in the file. Can be called again
+        // with more files of the same nodes.
+        void read(const std::string& file_name);
+
+        int64_t number_of_nodes() const;
+        int64_t number_of_edges() const;  // Edges read so far
+        int64_t number_of_components() const;
+
+        // Read-only copy of the components so far
+        FrozenConnectivity components();
+
+        // Write the component label of each node, one per line in node
+        // order, with labels as in FrozenConnectivity
+        void write_labels(const std::string& file_name);
+
+        // Write "size count" lines, the number of components of each size,
+        // smallest size first
+        void write_histogram(const std::string& file_name);
+
+    private:
+        const EdgeListOptions options;
+        const int threads;
+        int64_t nodes;
+        int64_t edges = 0;
+        std::unique_ptr<ConcurrentUnionFind> grid;
+    };
+
+#pragma endregion Edge List Components
+
+}
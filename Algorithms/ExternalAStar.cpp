@@ -0,0 +1,536 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <map>
+#include <queue>
+#include <set>
+#include <memory>
+#include <fstream>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include "ExternalAStar.h"
+
+using namespace std;
+using namespace PuzzleBoard;
+
+
+#pragma region External A*
+
+namespace
+{
+    // Bytes of the stream buffer of every open run
+    const size_t block_size = 1 << 16;
+
+    // Smallest memory limit that still merges a few runs at a time
+    const size_t min_memory_limit = 1 << 20;
+
+    // Bytes of a map node on top of its value: colour, parent and children
+    const size_t map_node_size = 4 * sizeof(void*);
+
+    // Bytes of a path kept in memory
+    size_t path_size(const string& path)
+    {
+        return sizeof(string) + path.capacity() + 1;
+    }
+
+    // Temporary files of one search, removed when it ends or throws
+    class TempFiles {
+    public:
+        explicit TempFiles(const string& directory)
+        {
+            static atomic<unsigned> searches(0);
+            auto ticks = chrono::steady_clock::now().time_since_epoch().count();
+            prefix = (directory.empty() ? string(".") : directory) + "/puzzle-"
+                + to_string(ticks) + "-" + to_string(searches++) + "-";
+        }
+
+        ~TempFiles()
+        {
+            for (const string& path : paths) {
+                ::remove(path.c_str());
+            }
+        }
+
+        // Path of a new file
+        string create()
+        {
+            string path = prefix + to_string(count++) + ".run";
+            paths.insert(path);
+            return path;
+        }
+
+        // Remove a file that is no longer needed
+        void remove(const string& path)
+        {
+            ::remove(path.c_str());
+            paths.erase(path);
+        }
+
+    private:
+        string prefix;
+        set<string> paths;
+        int count = 0;
+    };
+
+    // Writes a run of boards, which should come in increasing key order.
+    // Each key is stored as the length of the prefix it shares with the
+    // previous key, then the rest of its bytes and the move byte.
+    class RunWriter {
+    public:
+        RunWriter(const string& path, size_t key_size)
+            : path(path), buffer(block_size), previous(key_size, '\0')
+        {
+            file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+            file.open(path, ios::binary | ios::trunc);
+            if (!file) {
+                throw runtime_error("External A*: cannot create " + path + "!");
+            }
+        }
+
+        void write(const char* key, Move move)
+        {
+            size_t prefix = 0;
+            if (count > 0) {
+                while (prefix < previous.size() && previous[prefix] == key[prefix]) {
+                    ++prefix;
+                }
+            }
+
+            // Prefix length in base 128, low digits first
+            size_t length = prefix;
+            while (length >= 0x80) {
+                file.put(static_cast<char>((length & 0x7F) | 0x80));
+                length >>= 7;
+            }
+            file.put(static_cast<char>(length));
+            file.write(key + prefix, previous.size() - prefix);
+            file.put(static_cast<char>(move));
+
+            previous.replace(prefix, string::npos, key + prefix, previous.size() - prefix);
+            ++count;
+        }
+
+        void close()
+        {
+            file.close();
+            if (!file) {
+                throw runtime_error("External A*: cannot write " + path + "!");
+            }
+        }
+
+    private:
+        string path;
+        vector<char> buffer;
+        ofstream file;
+        string previous;
+        uint64_t count = 0;
+    };
+
+    // Reads a run written by RunWriter, one board at a time
+    class RunReader {
+    public:
+        string key;  // Key and move of the board read last
+        Move move = Move::up;
+
+        RunReader(const string& path, size_t key_size)
+            : key(key_size, '\0'), path(path), buffer(block_size)
+        {
+            file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+            file.open(path, ios::binary);
+            if (!file) {
+                throw runtime_error("External A*: cannot open " + path + "!");
+            }
+        }
+
+        // Read the next board, return false at the end of the run
+        bool next()
+        {
+            int byte = file.get();
+            if (byte == EOF) {
+                return false;
+            }
+            size_t prefix = 0;
+            for (int shift = 0; ; shift += 7) {
+                if (byte == EOF) {
+                    throw runtime_error("External A*: " + path + " is corrupt!");
+                }
+                prefix |= static_cast<size_t>(byte & 0x7F) << shift;
+                if (!(byte & 0x80)) {
+                    break;
+                }
+                byte = file.get();
+            }
+
+            if (prefix >= key.size()) {
+                throw runtime_error("External A*: " + path + " is corrupt!");
+            }
+            file.read(&key[prefix], key.size() - prefix);
+            byte = file.get();
+            if (!file) {
+                throw runtime_error("External A*: " + path + " is corrupt!");
+            }
+            move = static_cast<Move>(byte);
+            return true;
+        }
+
+    private:
+        string path;
+        vector<char> buffer;
+        ifstream file;
+    };
+
+    // Boards of equal moves and heuristic value waiting to be expanded
+    struct Bucket {
+        string buffer;        // Keys and move bytes, not sorted yet
+        vector<string> runs;  // Sorted runs on disk
+    };
+
+    class ExternalSearch {
+    public:
+        ExternalSearch(const Board& initial, Heuristic heuristic, size_t memory_limit,
+                       const string& temp_directory, SolverStats& stats)
+            : initial(initial), heuristic(heuristic), memory_limit(memory_limit),
+              key_size(initial.key().size()), files(temp_directory), stats(stats)
+        {
+            // Half of the memory buffers boards, the rest reads and writes runs.
+            // Expanding a bucket merges fan_in runs with the two buckets before
+            // it, writes the expanded bucket, and may flush the boards it makes.
+            fan_in = max<size_t>(2, memory_limit / 2 / block_size - 4);
+            stream_size = max(sizeof(RunReader), sizeof(RunWriter)) + block_size
+                + key_size + sizeof(unique_ptr<RunReader>) + sizeof(pair<const string*, size_t>);
+        }
+
+        int run(vector<Move>& moves)
+        {
+            moves.clear();
+            int initial_estimate = initial.heuristic(heuristic);
+            if (initial_estimate == 0) {
+                return 0;
+            }
+            add(0, initial_estimate, initial.key(), Move::up);
+
+            while (!open.empty()) {
+                auto first = open.begin();
+                int moves_made = first->first.second;
+                int estimate = first->first.first - moves_made;
+                bool found = expand(moves_made, estimate, first->second);
+                streams = 1;
+                erase(first);
+
+                if (found) {
+                    // Only the expanded buckets lead back to the initial board
+                    while (!open.empty()) {
+                        erase(open.begin());
+                    }
+                    rebuild(moves_made, moves);
+                    return moves_made;
+                }
+            }
+
+            throw logic_error("External A*: no solution for a solvable board!");
+        }
+
+    private:
+        const Board& initial;
+        const Heuristic heuristic;
+        const size_t memory_limit;
+        const size_t key_size;
+        size_t fan_in;       // Most runs merged at once
+        size_t stream_size;  // Bytes of a run being read or written
+        size_t streams = 1;  // Runs open at once, a flush writer at least
+        TempFiles files;
+        SolverStats& stats;
+
+        typedef map<pair<int, int>, Bucket> OpenBuckets;
+        typedef map<pair<int, int>, string> ClosedBuckets;
+        OpenBuckets open;       // By estimated total moves, then moves
+        ClosedBuckets closed;   // Expanded boards by moves and heuristic value
+        size_t buffered = 0;    // Bytes of the bucket buffers
+        size_t boards = 0;      // Boards in the bucket buffers
+        size_t bookkeeping = 0; // Bytes of the bucket maps and run paths
+        string goal_key;
+        Move goal_move = Move::up;
+
+        // Bytes held in memory: the buffered boards with a pointer for each
+        // to sort them, the buckets and their paths, and the run streams
+        size_t memory_in_use() const
+        {
+            return buffered + boards * sizeof(char*) + bookkeeping + streams * stream_size;
+        }
+
+        // Bytes more that adding a board to the bucket takes: a pointer to
+        // sort it and, if its buffer grows, the new buffer next to the old one
+        size_t growth(const Bucket& bucket) const
+        {
+            size_t record_size = key_size + 1;
+            if (bucket.buffer.size() + record_size <= bucket.buffer.capacity()) {
+                return sizeof(char*);
+            }
+            return sizeof(char*) + 2 * bucket.buffer.capacity() + record_size;
+        }
+
+        // Flush every bucket unless the memory in use, and what adding a
+        // board to bucket would take, stays under the limit
+        void make_room(const Bucket* bucket = nullptr)
+        {
+            auto needed = [&] {
+                return memory_in_use() + (bucket != nullptr ? growth(*bucket) : 0);
+            };
+            if (needed() >= memory_limit) {
+                for (auto& entry : open) {
+                    flush(entry.second);
+                }
+                if (needed() >= memory_limit) {
+                    throw runtime_error("External A*: memory limit is too small for the buckets!");
+                }
+            }
+            SOLVER_STATS(stats.peak_node_memory = max(stats.peak_node_memory, needed()));
+        }
+
+        void add(int moves, int estimate, const string& key, Move move)
+        {
+            auto inserted = open.emplace(make_pair(moves + estimate, moves), Bucket());
+            Bucket& bucket = inserted.first->second;
+            if (inserted.second) {
+                bookkeeping += sizeof(OpenBuckets::value_type) + map_node_size;
+                buffered += bucket.buffer.capacity();
+            }
+            make_room(&bucket);
+
+            buffered -= bucket.buffer.capacity();
+            bucket.buffer.append(key);
+            bucket.buffer.push_back(static_cast<char>(move));
+            buffered += bucket.buffer.capacity();
+            ++boards;
+        }
+
+        // Drop an open bucket and its runs
+        void erase(OpenBuckets::iterator entry)
+        {
+            Bucket& bucket = entry->second;
+            for (const string& path : bucket.runs) {
+                bookkeeping -= path_size(path);
+                files.remove(path);
+            }
+            buffered -= bucket.buffer.capacity();
+            boards -= bucket.buffer.size() / (key_size + 1);
+            bookkeeping -= sizeof(OpenBuckets::value_type) + map_node_size;
+            open.erase(entry);
+        }
+
+        // Sort the buffered boards of a bucket and write them out as a run
+        void flush(Bucket& bucket)
+        {
+            if (bucket.buffer.empty()) {
+                return;
+            }
+
+            size_t record_size = key_size + 1;
+            size_t size = key_size;
+            vector<const char*> records;
+            records.reserve(bucket.buffer.size() / record_size);
+            for (size_t i = 0; i < bucket.buffer.size(); i += record_size) {
+                records.push_back(&bucket.buffer[i]);
+            }
+            sort(records.begin(), records.end(), [size](const char* a, const char* b) {
+                return memcmp(a, b, size) < 0;
+            });
+
+            string path = files.create();
+            RunWriter writer(path, key_size);
+            for (size_t i = 0; i < records.size(); ++i) {
+                if (i > 0 && memcmp(records[i - 1], records[i], key_size) == 0) {
+                    SOLVER_STATS(++stats.duplicates_pruned);
+                    continue;
+                }
+                writer.write(records[i], static_cast<Move>(records[i][key_size]));
+            }
+            writer.close();
+            bucket.runs.push_back(path);
+            bookkeeping += path_size(path);
+
+            buffered -= bucket.buffer.capacity();
+            boards -= records.size();
+            string().swap(bucket.buffer);
+            buffered += bucket.buffer.capacity();
+        }
+
+        // Merge runs into one, keeping only the first of equal keys.
+        // Each board is passed to visit, which returns false to stop early.
+        template <typename Visitor>
+        void merge(const vector<string>& runs, Visitor&& visit)
+        {
+            vector<unique_ptr<RunReader>> readers;
+            typedef pair<const string*, size_t> Head;
+            auto later = [](const Head& a, const Head& b) {
+                return *b.first < *a.first || (*b.first == *a.first && b.second < a.second);
+            };
+            priority_queue<Head, vector<Head>, decltype(later)> heads(later);
+            for (const string& path : runs) {
+                readers.emplace_back(new RunReader(path, key_size));
+                if (readers.back()->next()) {
+                    heads.push(Head(&readers.back()->key, readers.size() - 1));
+                }
+            }
+
+            string previous;
+            while (!heads.empty()) {
+                size_t index = heads.top().second;
+                RunReader& reader = *readers[index];
+                heads.pop();
+                if (reader.key != previous) {
+                    previous = reader.key;
+                    if (!visit(reader.key, reader.move)) {
+                        return;
+                    }
+                }
+                else {
+                    SOLVER_STATS(++stats.duplicates_pruned);
+                }
+                if (reader.next()) {
+                    heads.push(Head(&reader.key, index));
+                }
+            }
+        }
+
+        // Expand a bucket and return true if it holds the goal board
+        bool expand(int moves, int estimate, Bucket& bucket)
+        {
+            flush(bucket);
+            streams = fan_in + 1;
+            while (bucket.runs.size() > fan_in) {
+                make_room();
+                vector<string> group(bucket.runs.begin(), bucket.runs.begin() + fan_in);
+                string path = files.create();
+                RunWriter writer(path, key_size);
+                merge(group, [&](const string& key, Move move) {
+                    writer.write(key.data(), move);
+                    return true;
+                });
+                writer.close();
+                for (const string& run : group) {
+                    bookkeeping -= path_size(run);
+                    files.remove(run);
+                }
+                bucket.runs.erase(bucket.runs.begin(), bucket.runs.begin() + fan_in);
+                bucket.runs.push_back(path);
+                bookkeeping += path_size(path);
+            }
+
+            // With a consistent heuristic on an undirected graph, a board seen
+            // before was last expanded one or two moves earlier
+            streams = bucket.runs.size() + 2;
+            for (int back = 1; back <= 2 && back <= moves; ++back) {
+                streams += closed.count(make_pair(moves - back, estimate));
+            }
+            vector<unique_ptr<RunReader>> earlier;
+            vector<bool> more;
+            for (int back = 1; back <= 2 && back <= moves; ++back) {
+                auto found = closed.find(make_pair(moves - back, estimate));
+                if (found != closed.end()) {
+                    earlier.emplace_back(new RunReader(found->second, key_size));
+                    more.push_back(earlier.back()->next());
+                }
+            }
+
+            string path = files.create();
+            closed[make_pair(moves, estimate)] = path;
+            bookkeeping += sizeof(ClosedBuckets::value_type) + map_node_size + path_size(path);
+            make_room();
+            RunWriter writer(path, key_size);
+            bool found = false;
+
+            merge(bucket.runs, [&](const string& key, Move move) {
+                for (size_t i = 0; i < earlier.size(); ++i) {
+                    while (more[i] && earlier[i]->key < key) {
+                        more[i] = earlier[i]->next();
+                    }
+                    if (more[i] && earlier[i]->key == key) {
+                        SOLVER_STATS(++stats.duplicates_pruned);
+                        return true;
+                    }
+                }
+
+                writer.write(key.data(), move);
+                if (estimate == 0) {
+                    // Every heuristic is zero at the goal board only
+                    goal_key = key;
+                    goal_move = move;
+                    found = true;
+                    return false;
+                }
+
+                Board board = Board::from_key(key);
+                SOLVER_STATS(++stats.nodes_expanded);
+                auto visit = [&](const Board& neighbour, Move neighbour_move, int, int delta) {
+                    add(moves + 1, estimate + delta, neighbour.key(), neighbour_move);
+                    SOLVER_STATS(++stats.nodes_generated);
+                };
+                if (moves == 0) {
+                    board.for_each_neighbour(heuristic, visit);
+                }
+                else {
+                    board.for_each_neighbour(heuristic, PuzzleBoard::reverse(move), visit);
+                }
+                return true;
+            });
+            writer.close();
+
+            return found;
+        }
+
+        // Walk back from the goal board through the expanded buckets
+        void rebuild(int number_of_moves, vector<Move>& moves)
+        {
+            moves.assign(number_of_moves, Move::up);
+            Board board = Board::from_key(goal_key);
+            Move move = goal_move;
+
+            for (int i = number_of_moves; i > 0; --i) {
+                // Buckets of i moves or more are behind the walk now
+                for (auto entry = closed.lower_bound(make_pair(i, 0)); entry != closed.end(); ) {
+                    files.remove(entry->second);
+                    entry = closed.erase(entry);
+                }
+
+                moves[i - 1] = move;
+                board.move(PuzzleBoard::reverse(move));
+                if (i == 1) {
+                    break;
+                }
+
+                string key = board.key();
+                auto parent = closed.find(make_pair(i - 1, board.heuristic(heuristic)));
+                if (parent == closed.end()) {
+                    throw logic_error("External A*: lost a board of the solution!");
+                }
+                RunReader reader(parent->second, key_size);
+                bool more = reader.next();
+                while (more && reader.key < key) {
+                    more = reader.next();
+                }
+                if (!more || reader.key != key) {
+                    throw logic_error("External A*: lost a board of the solution!");
+                }
+                move = reader.move;
+            }
+        }
+    };
+}
+
+int PuzzleBoard::external_a_star(const Board& initial, Heuristic heuristic, size_t memory_limit,
+                                 const string& temp_directory,
+                                 vector<Move>& moves, SolverStats& stats)
+{
+    if (memory_limit < min_memory_limit) {
+        throw invalid_argument("External A*: memory limit should be at least 1 MiB!");
+    }
+
+    ExternalSearch search(initial, heuristic, memory_limit, temp_directory, stats);
+    return search.run(moves);
+}
+
+#pragma endregion External A*
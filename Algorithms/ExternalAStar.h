@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "AStar.h"
+
+namespace PuzzleBoard
+{
+
+#pragma region External A*
+
+    // External-memory A* for boards whose search does not fit in RAM.
+    // Boards are kept on disk in buckets of equal moves and heuristic value,
+    // which are expanded in order of estimated total moves. Generated boards
+    // are buffered in memory, and every time the buffers, the buckets and
+    // the stream buffers of the runs read and written reach memory_limit
+    // bytes, the boards are sorted and written out as runs, each key stored
+    // as the length of the prefix it shares with the previous one and the
+    // rest of its bytes. A bucket is expanded by merging its runs, which
+    // also drops duplicates and the boards already seen one and two moves
+    // earlier, and its runs are removed right after. Expanded buckets stay
+    // on disk to rebuild the solution, and are removed as the walk back
+    // passes them. The stats report the peak of memory counted this way.
+    // Temporary files go to temp_directory, or to the working directory if
+    // it is empty, and are removed before returning.
+    // Return the minimum number of moves and fill moves with the moves of the
+    // empty tile. The initial board should be solvable.
+    int external_a_star(const Board& initial, Heuristic heuristic, size_t memory_limit,
+                        const std::string& temp_directory,
+                        std::vector<Move>& moves, SolverStats& stats);
+
+#pragma endregion External A*
+
+}
@@ -0,0 +1,328 @@
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <exception>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "GridLabeling.h"
+
+using namespace UnionFind;
+using namespace std;
+
+
+#pragma region Grid Labeling
+
+OccupancyGrid::OccupancyGrid(int64_t rows, int64_t cols)
+    : number_of_rows(rows), number_of_cols(cols), words(cols > 0 ? (cols + 63) / 64 : 0)
+{
+    if (rows <= 0 || cols <= 0) {
+        throw invalid_argument("OccupancyGrid: rows and cols should be positive!");
+    }
+
+    bits.assign(static_cast<size_t>(rows * words), 0);
+}
+
+void OccupancyGrid::set(int64_t row, int64_t col, bool open)
+{
+    check(row, col);
+
+    uint64_t& word = bits[row * words + (col >> 6)];
+    uint64_t bit = uint64_t(1) << (col & 63);
+    word = open ? word | bit : word & ~bit;
+}
+
+bool OccupancyGrid::is_open(int64_t row, int64_t col) const
+{
+    check(row, col);
+
+    return (bits[row * words + (col >> 6)] >> (col & 63)) & 1;
+}
+
+int64_t OccupancyGrid::rows() const
+{
+    return number_of_rows;
+}
+
+int64_t OccupancyGrid::cols() const
+{
+    return number_of_cols;
+}
+
+int64_t OccupancyGrid::words_per_row() const
+{
+    return words;
+}
+
+const uint64_t* OccupancyGrid::row_words(int64_t row) const
+{
+    return bits.data() + row * words;
+}
+
+void OccupancyGrid::check(int64_t row, int64_t col) const
+{
+    if (row < 0 || row > number_of_rows - 1 || col < 0 || col > number_of_cols - 1) {
+        throw invalid_argument("OccupancyGrid: row and col should be within the grid!");
+    }
+}
+
+
+namespace
+{
+    // Index of the lowest set bit of a nonzero word
+    int lowest_bit(uint64_t x)
+    {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, x);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctzll(x);
+#endif
+    }
+
+    int count_bits(uint64_t x)
+    {
+#if defined(_MSC_VER)
+        return static_cast<int>(__popcnt64(x));
+#else
+        return __builtin_popcountll(x);
+#endif
+    }
+
+    // Open sites whose left neighbour is blocked, for 64 sites at once.
+    // carry is the last site of the word before.
+    uint64_t run_starts(uint64_t x, uint64_t carry)
+    {
+        return x & ~((x << 1) | carry);
+    }
+
+    // Open sites whose right neighbour is blocked. next is the word after.
+    uint64_t run_ends(uint64_t x, uint64_t next)
+    {
+        return x & ~((x >> 1) | (next << 63));
+    }
+
+    // Open sites from start to end - 1 of one row
+    struct Run {
+        int64_t start;
+        int64_t end;
+    };
+
+    // Runs of a band of rows, row by row
+    struct Stripe {
+        int64_t first_row;
+        int64_t last_row;        // One past the last row
+        std::vector<Run> runs;
+        std::vector<int64_t> row_start;  // First run of each row, and one past the last run
+        int64_t first_run = 0;   // Index of the first run among all stripes
+    };
+
+    // Number of runs in a row
+    int64_t count_runs(const uint64_t* words, int64_t count)
+    {
+        int64_t runs = 0;
+        uint64_t carry = 0;
+        for (int64_t i = 0; i < count; ++i) {
+            runs += count_bits(run_starts(words[i], carry));
+            carry = words[i] >> 63;
+        }
+        return runs;
+    }
+
+    // Find the runs of a row from the bits where runs start and end, found
+    // for a whole word at a time. Starts and ends take turns along the row,
+    // so each end closes the oldest run still open.
+    void find_runs(const uint64_t* words, int64_t count, std::vector<Run>& runs)
+    {
+        size_t open = runs.size();  // First run without an end
+        uint64_t carry = 0;
+        for (int64_t i = 0; i < count; ++i) {
+            uint64_t x = words[i];
+            if (x == 0) {
+                carry = 0;
+                continue;
+            }
+            uint64_t next = i + 1 < count ? words[i + 1] : 0;
+            int64_t base = i * 64;
+
+            for (uint64_t starts = run_starts(x, carry); starts != 0; starts &= starts - 1) {
+                runs.push_back(Run{ base + lowest_bit(starts), 0 });
+            }
+            for (uint64_t ends = run_ends(x, next); ends != 0; ends &= ends - 1) {
+                runs[open++].end = base + lowest_bit(ends) + 1;
+            }
+            carry = x >> 63;
+        }
+    }
+
+    // Connect the runs of two neighbouring rows that share a column, walking
+    // both lists in order of where the runs end
+    void connect_rows(const Run* upper, int64_t upper_count, int64_t upper_first,
+                      const Run* lower, int64_t lower_count, int64_t lower_first,
+                      CompactUnionFind& runs)
+    {
+        int64_t i = 0;
+        int64_t j = 0;
+        while (i < upper_count && j < lower_count) {
+            if (upper[i].start < lower[j].end && lower[j].start < upper[i].end) {
+                runs.connect_unchecked(upper_first + i, lower_first + j);
+            }
+            if (upper[i].end < lower[j].end) {
+                ++i;
+            }
+            else {
+                ++j;
+            }
+        }
+    }
+
+    // Call work(i) for i from 0 to count - 1, one thread each
+    template <class Work>
+    void run_threads(int count, Work work)
+    {
+        mutex error_mutex;
+        exception_ptr error;
+        auto guarded = [&](int i) {
+            try {
+                work(i);
+            }
+            catch (...) {
+                lock_guard<mutex> lock(error_mutex);
+                if (!error) {
+                    error = current_exception();
+                }
+            }
+        };
+
+        vector<thread> workers;
+        for (int i = 1; i < count; ++i) {
+            workers.emplace_back(guarded, i);
+        }
+        guarded(0);
+        for (thread& worker : workers) {
+            worker.join();
+        }
+
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+}
+
+GridLabels UnionFind::label_components(const OccupancyGrid& grid, int threads)
+{
+    if (threads < 0) {
+        throw invalid_argument("label_components: threads should not be negative!");
+    }
+    if (threads == 0) {
+        threads = max(1, static_cast<int>(thread::hardware_concurrency()));
+    }
+    int stripe_count = static_cast<int>(min<int64_t>(threads, grid.rows()));
+
+    vector<Stripe> stripes(stripe_count);
+    for (int s = 0; s < stripe_count; ++s) {
+        stripes[s].first_row = grid.rows() * s / stripe_count;
+        stripes[s].last_row = grid.rows() * (s + 1) / stripe_count;
+    }
+
+    // First pass: runs of each stripe
+    run_threads(stripe_count, [&](int s) {
+        Stripe& stripe = stripes[s];
+        int64_t count = 0;
+        for (int64_t row = stripe.first_row; row < stripe.last_row; ++row) {
+            count += count_runs(grid.row_words(row), grid.words_per_row());
+        }
+        stripe.runs.reserve(static_cast<size_t>(count));
+        stripe.row_start.reserve(static_cast<size_t>(stripe.last_row - stripe.first_row + 1));
+
+        for (int64_t row = stripe.first_row; row < stripe.last_row; ++row) {
+            stripe.row_start.push_back(static_cast<int64_t>(stripe.runs.size()));
+            find_runs(grid.row_words(row), grid.words_per_row(), stripe.runs);
+        }
+        stripe.row_start.push_back(static_cast<int64_t>(stripe.runs.size()));
+    });
+
+    int64_t total_runs = 0;
+    for (Stripe& stripe : stripes) {
+        stripe.first_run = total_runs;
+        total_runs += static_cast<int64_t>(stripe.runs.size());
+    }
+
+    GridLabels result;
+    result.labels.assign(static_cast<size_t>(grid.rows() * grid.cols()), -1);
+    if (total_runs == 0) {
+        return result;
+    }
+
+    // Still the first pass: connect runs within each stripe. Stripes hold
+    // different runs, so their trees never meet and threads cannot clash.
+    CompactUnionFind runs(total_runs);
+    run_threads(stripe_count, [&](int s) {
+        const Stripe& stripe = stripes[s];
+        for (int64_t r = 1; r < stripe.last_row - stripe.first_row; ++r) {
+            int64_t upper = stripe.row_start[r - 1];
+            int64_t lower = stripe.row_start[r];
+            connect_rows(stripe.runs.data() + upper, lower - upper, stripe.first_run + upper,
+                         stripe.runs.data() + lower, stripe.row_start[r + 1] - lower, stripe.first_run + lower,
+                         runs);
+        }
+    });
+
+    // Join the stripes along the rows where they meet
+    for (int s = 1; s < stripe_count; ++s) {
+        const Stripe& upper = stripes[s - 1];
+        const Stripe& lower = stripes[s];
+        int64_t upper_rows = upper.last_row - upper.first_row;
+        int64_t upper_start = upper.row_start[upper_rows - 1];
+        connect_rows(upper.runs.data() + upper_start, upper.row_start[upper_rows] - upper_start,
+                     upper.first_run + upper_start,
+                     lower.runs.data(), lower.row_start[1], lower.first_run, runs);
+    }
+
+    // Second pass: number the components in order of their first run,
+    // which is the order of their first site
+    vector<int64_t> run_label(static_cast<size_t>(total_runs), -1);
+    vector<int64_t> root_label(static_cast<size_t>(total_runs), -1);
+    for (int64_t i = 0; i < total_runs; ++i) {
+        int64_t root = runs.find_unchecked(i);
+        if (root_label[root] < 0) {
+            root_label[root] = result.components++;
+        }
+        run_label[i] = root_label[root];
+    }
+    vector<int64_t>().swap(root_label);
+
+    run_threads(stripe_count, [&](int s) {
+        const Stripe& stripe = stripes[s];
+        for (int64_t r = 0; r < stripe.last_row - stripe.first_row; ++r) {
+            int64_t* row = result.labels.data() + (stripe.first_row + r) * grid.cols();
+            for (int64_t i = stripe.row_start[r]; i < stripe.row_start[r + 1]; ++i) {
+                const Run& run = stripe.runs[i];
+                fill(row + run.start, row + run.end, run_label[stripe.first_run + i]);
+            }
+        }
+    });
+
+    // A component connects top and bottom if a run of the first row and a
+    // run of the last row share its label
+    vector<bool> on_top(static_cast<size_t>(result.components), false);
+    const Stripe& top = stripes.front();
+    for (int64_t i = top.row_start[0]; i < top.row_start[1]; ++i) {
+        on_top[run_label[top.first_run + i]] = true;
+    }
+    const Stripe& bottom = stripes.back();
+    int64_t bottom_rows = bottom.last_row - bottom.first_row;
+    for (int64_t i = bottom.row_start[bottom_rows - 1]; i < bottom.row_start[bottom_rows]; ++i) {
+        if (on_top[run_label[bottom.first_run + i]]) {
+            result.top_bottom_connected = true;
+            break;
+        }
+    }
+
+    return result;
+}
+
+#pragma endregion Grid Labeling
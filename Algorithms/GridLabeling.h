@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "UnionFind.h"
+
+namespace UnionFind
+{
+
+#pragma region Grid Labeling
+
+    // Open or blocked sites of a grid, one bit each. Rows are stored one
+    // after another, each padded to whole 64-bit words with blocked sites.
+    class OccupancyGrid {
+    public:
+        OccupancyGrid(int64_t rows, int64_t cols);  // Creates a grid of blocked sites
+
+        // Zero-based row and col
+        void set(int64_t row, int64_t col, bool open);
+        bool is_open(int64_t row, int64_t col) const;
+
+        int64_t rows() const;
+        int64_t cols() const;
+        int64_t words_per_row() const;
+        const uint64_t* row_words(int64_t row) const;  // Bit c % 64 of word c / 64 is col c
+
+    private:
+        const int64_t number_of_rows;
+        const int64_t number_of_cols;
+        const int64_t words;
+        std::vector<uint64_t> bits;
+
+        void check(int64_t row, int64_t col) const;
+    };
+
+    // Components of the open sites of a grid, with 4-connected neighbours
+    struct GridLabels {
+        std::vector<int64_t> labels;  // Label of each site in row order, -1 if blocked
+        int64_t components = 0;       // Labels run from 0 to components - 1
+        bool top_bottom_connected = false;  // Does a component touch the first and last rows?
+    };
+
+    // Label a whole grid at once with a two-pass scan over runs of open
+    // sites. The first pass finds the runs of each row from whole words,
+    // 64 sites at a time, and connects overlapping runs of neighbouring rows
+    // in a union-find over the runs. The second pass numbers the components
+    // in order of their first site and writes the label of each run.
+    // Rows are split into stripes, one for each of threads threads, which
+    // are scanned at once and then joined along the rows where they meet.
+    GridLabels label_components(const OccupancyGrid& grid, int threads = 1);
+
+#pragma endregion Grid Labeling
+
+}
@@ -0,0 +1,408 @@
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+#include <climits>
+#include "ParallelAStar.h"
+
+using namespace std;
+using namespace PuzzleBoard;
+
+
+#pragma region Parallel A*
+
+namespace
+{
+    // Boards go to their owners in batches of this many
+    const size_t batch_size = 64;
+
+    // Nodes expanded between two looks at the inbox
+    const int expansions_per_round = 64;
+
+    // Best known way to reach a board. The parent may be owned by another
+    // thread and is only followed once the search is over.
+    struct Record {
+        int moves;
+        const Record* parent;
+        Move move;  // Move of the empty tile from the parent board
+    };
+
+    typedef unordered_map<string, Record> ClosedSet;
+
+    // A generated board on its way to its owner
+    struct Message {
+        string key;
+        int moves;
+        int estimate;
+        const Record* parent;
+        Move move;
+    };
+
+    struct Batch {
+        Batch* next;
+        vector<Message> messages;
+    };
+
+    // Many threads push batches and the owner takes all of them at once,
+    // so a compare-and-swap on the head is the only synchronisation needed
+    class Inbox {
+    public:
+        ~Inbox()
+        {
+            Batch* batch = take_all();
+            while (batch != nullptr) {
+                Batch* next = batch->next;
+                delete batch;
+                batch = next;
+            }
+        }
+
+        void push(Batch* batch)
+        {
+            batch->next = head.load(memory_order_relaxed);
+            while (!head.compare_exchange_weak(batch->next, batch,
+                                               memory_order_release, memory_order_relaxed)) {
+            }
+        }
+
+        Batch* take_all()
+        {
+            return head.exchange(nullptr, memory_order_acquire);
+        }
+
+    private:
+        atomic<Batch*> head{ nullptr };
+    };
+
+    struct OpenEntry {
+        int priority;
+        int moves;
+        int estimate;
+        const ClosedSet::value_type* state;
+
+        bool operator<(const OpenEntry& other) const {
+            return priority < other.priority
+                || (priority == other.priority && moves > other.moves);
+        }
+        bool operator<=(const OpenEntry& other) const {
+            return !(other < *this);
+        }
+    };
+
+    struct Worker {
+        Inbox inbox;
+        ClosedSet closed;
+        Sorting::MinPriorityQueue<OpenEntry> open;
+        vector<Batch*> outgoing;  // Batch being filled for each thread
+        SolverStats stats;
+    };
+
+#ifdef PUZZLE_SOLVER_STATS
+    // Bytes held by the closed and open sets of a worker. A closed set node
+    // holds its entry, the key bytes and a link, and every bucket a pointer.
+    size_t worker_memory(const Worker& worker)
+    {
+        size_t key_bytes = worker.closed.empty() ? 0 : worker.closed.begin()->first.capacity() + 1;
+        return worker.closed.size() * (sizeof(ClosedSet::value_type) + key_bytes + sizeof(void*))
+            + worker.closed.bucket_count() * sizeof(void*)
+            + worker.open.size() * sizeof(OpenEntry);
+    }
+#endif
+
+    class Search {
+    public:
+        Search(Heuristic heuristic, int threads)
+            : heuristic(heuristic), threads(threads)
+        {
+            for (int i = 0; i < threads; ++i) {
+                workers.emplace_back(new Worker);
+                workers.back()->outgoing.assign(threads, nullptr);
+            }
+        }
+
+        ~Search()
+        {
+            for (auto& worker : workers) {
+                for (Batch* batch : worker->outgoing) {
+                    delete batch;
+                }
+            }
+        }
+
+        int owner(uint64_t hash) const
+        {
+            return static_cast<int>(hash % threads);
+        }
+
+        void insert(int id, Message& message);
+        void run(int id);
+
+        const Heuristic heuristic;
+        const int threads;
+        vector<unique_ptr<Worker>> workers;
+
+        atomic<int> best{ INT_MAX };  // Moves of the best solution found
+        const Record* goal = nullptr;
+        mutex goal_mutex;
+
+        // Termination detection. A thread is idle when its inbox is empty and
+        // its open set holds nothing better than the best solution. Search
+        // ends when all threads are idle, every message sent was received,
+        // and no thread woke up while that was being checked.
+        atomic<int> idle_count{ 0 };
+        atomic<uint64_t> wake_ups{ 0 };
+        atomic<uint64_t> sent{ 0 };
+        atomic<uint64_t> received{ 0 };
+        atomic<bool> done{ false };
+
+        exception_ptr error;
+        mutex error_mutex;
+
+    private:
+        void expand(int id, const OpenEntry& entry);
+        void send(int id, int to, Message&& message);
+        void flush(int id);
+        bool is_finished() const;
+    };
+
+    void Search::insert(int id, Message& message)
+    {
+        Worker& worker = *workers[id];
+        if (message.moves + message.estimate >= best) {
+            return;
+        }
+
+        auto result = worker.closed.emplace(move(message.key), Record{ message.moves, message.parent, message.move });
+        Record& record = result.first->second;
+        if (!result.second) {
+            if (record.moves <= message.moves) {
+                SOLVER_STATS(++worker.stats.duplicates_pruned);
+                return;
+            }
+            record = Record{ message.moves, message.parent, message.move };
+        }
+
+        // Every heuristic is zero at the goal board only
+        if (message.estimate == 0) {
+            lock_guard<mutex> lock(goal_mutex);
+            if (message.moves < best) {
+                best = message.moves;
+                goal = &record;
+            }
+            return;
+        }
+
+        worker.open.push(OpenEntry{ message.moves + message.estimate, message.moves,
+                                    message.estimate, &*result.first });
+        SOLVER_STATS(worker.stats.peak_open_set = max(worker.stats.peak_open_set,
+                                                      static_cast<size_t>(worker.open.size())));
+    }
+
+    void Search::expand(int id, const OpenEntry& entry)
+    {
+        const Record& record = entry.state->second;
+        Board board = Board::from_key(entry.state->first);
+        SOLVER_STATS(++workers[id]->stats.nodes_expanded);
+
+        auto visit = [&](const Board& neighbour, Move move, int, int delta) {
+            int moves = entry.moves + 1;
+            int estimate = entry.estimate + delta;
+            if (moves + estimate >= best) {
+                return;
+            }
+
+            SOLVER_STATS(++workers[id]->stats.nodes_generated);
+            Message message{ neighbour.key(), moves, estimate, &record, move };
+            int to = owner(neighbour.hash());
+            if (to == id) {
+                insert(id, message);
+            }
+            else {
+                send(id, to, std::move(message));
+            }
+        };
+
+        if (record.parent == nullptr) {
+            board.for_each_neighbour(heuristic, visit);
+        }
+        else {
+            board.for_each_neighbour(heuristic, PuzzleBoard::reverse(record.move), visit);
+        }
+    }
+
+    void Search::send(int id, int to, Message&& message)
+    {
+        Batch*& batch = workers[id]->outgoing[to];
+        if (batch == nullptr) {
+            batch = new Batch;
+            batch->messages.reserve(batch_size);
+        }
+
+        batch->messages.push_back(move(message));
+        if (batch->messages.size() == batch_size) {
+            // Count before pushing, so received never runs ahead of sent
+            sent += batch->messages.size();
+            workers[to]->inbox.push(batch);
+            batch = nullptr;
+        }
+    }
+
+    void Search::flush(int id)
+    {
+        for (int to = 0; to < threads; ++to) {
+            Batch*& batch = workers[id]->outgoing[to];
+            if (batch != nullptr) {
+                sent += batch->messages.size();
+                workers[to]->inbox.push(batch);
+                batch = nullptr;
+            }
+        }
+    }
+
+    bool Search::is_finished() const
+    {
+        // Received is read before sent, so equal counts mean nothing was
+        // in flight in between
+        uint64_t before = wake_ups;
+        if (idle_count != threads) {
+            return false;
+        }
+        uint64_t received_count = received;
+        uint64_t sent_count = sent;
+        return received_count == sent_count && idle_count == threads && wake_ups == before;
+    }
+
+    void Search::run(int id)
+    {
+        Worker& worker = *workers[id];
+        bool idle = false;
+
+        while (!done) {
+            bool busy = false;
+
+            Batch* batch = worker.inbox.take_all();
+            if (batch != nullptr) {
+                if (idle) {
+                    ++wake_ups;
+                    --idle_count;
+                    idle = false;
+                }
+                busy = true;
+
+                uint64_t count = 0;
+                while (batch != nullptr) {
+                    for (Message& message : batch->messages) {
+                        insert(id, message);
+                        ++count;
+                    }
+                    Batch* next = batch->next;
+                    delete batch;
+                    batch = next;
+                }
+                received += count;
+            }
+
+            for (int i = 0; i < expansions_per_round && !worker.open.is_empty(); ++i) {
+                OpenEntry entry = worker.open.min();
+                if (entry.priority >= best) {
+                    break;
+                }
+                worker.open.pop_min();
+
+                // Skip entries of boards that were reached in fewer moves later
+                if (entry.state->second.moves < entry.moves) {
+                    continue;
+                }
+                expand(id, entry);
+                busy = true;
+            }
+            flush(id);
+            SOLVER_STATS(worker.stats.peak_node_memory = max(worker.stats.peak_node_memory, worker_memory(worker)));
+
+            if (!busy) {
+                if (!idle) {
+                    idle = true;
+                    ++idle_count;
+                }
+                if (is_finished()) {
+                    done = true;
+                }
+                this_thread::yield();
+            }
+        }
+    }
+}
+
+int PuzzleBoard::parallel_a_star(const Board& initial, Heuristic heuristic, int threads,
+                                 vector<Move>& moves, SolverStats& stats)
+{
+    if (threads < 0) {
+        throw invalid_argument("parallel_a_star: threads should not be negative!");
+    }
+    if (threads == 0) {
+        threads = max(1, static_cast<int>(thread::hardware_concurrency()));
+    }
+    moves.clear();
+    if (initial.is_goal()) {
+        return 0;
+    }
+    if (heuristic == Heuristic::walking_distance) {
+        // Build the shared table before the threads read it
+        WalkingDistance::table(initial.dimension());
+    }
+
+    Search search(heuristic, threads);
+    Message root{ initial.key(), 0, initial.heuristic(heuristic), nullptr, Move::up };
+    search.insert(search.owner(initial.hash()), root);
+
+    auto work = [&search](int id) {
+        try {
+            search.run(id);
+        }
+        catch (...) {
+            lock_guard<mutex> lock(search.error_mutex);
+            if (!search.error) {
+                search.error = current_exception();
+            }
+            search.done = true;
+        }
+    };
+    vector<thread> workers;
+    for (int id = 1; id < threads; ++id) {
+        workers.emplace_back(work, id);
+    }
+    work(0);
+    for (thread& worker : workers) {
+        worker.join();
+    }
+    if (search.error) {
+        rethrow_exception(search.error);
+    }
+
+    for (const Record* record = search.goal; record->parent != nullptr; record = record->parent) {
+        moves.push_back(record->move);
+    }
+    reverse(moves.begin(), moves.end());
+
+#ifdef PUZZLE_SOLVER_STATS
+    // Peaks of different threads may come at different times, so their
+    // sums are upper bounds
+    for (auto& worker : search.workers) {
+        stats.nodes_generated += worker->stats.nodes_generated;
+        stats.nodes_expanded += worker->stats.nodes_expanded;
+        stats.duplicates_pruned += worker->stats.duplicates_pruned;
+        stats.peak_open_set += worker->stats.peak_open_set;
+        stats.peak_node_memory += worker->stats.peak_node_memory;
+    }
+#else
+    (void)stats;
+#endif
+
+    return search.best;
+}
+
+#pragma endregion Parallel A*
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+#include "AStar.h"
+
+namespace PuzzleBoard
+{
+
+#pragma region Parallel A*
+
+    // Hash-distributed A* (HDA*) on a number of threads, or one per hardware
+    // thread if threads is 0. Every board is owned by the thread chosen by its
+    // Zobrist hash, which keeps it in its own open and closed sets. Threads
+    // send generated boards to their owners through lock-free inboxes, and
+    // stop together once no board in an open set or on its way to one can
+    // lead to a shorter solution, so the result is still optimal.
+    // Return the minimum number of moves and fill moves with the moves of the
+    // empty tile. The initial board should be solvable.
+    int parallel_a_star(const Board& initial, Heuristic heuristic, int threads,
+                        std::vector<Move>& moves, SolverStats& stats);
+
+#pragma endregion Parallel A*
+
+}
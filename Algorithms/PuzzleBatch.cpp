@@ -0,0 +1,155 @@
+#include <stdexcept>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include "PuzzleBatch.h"
+
+using namespace std;
+using namespace PuzzleBoard;
+
+
+#pragma region Batch Solver
+
+BatchSolver::BatchSolver(const SolverOptions& options, int threads)
+    : options(options)
+{
+    if (threads < 0) {
+        throw invalid_argument("BatchSolver: threads should not be negative!");
+    }
+    if (threads == 0) {
+        threads = max(1, static_cast<int>(thread::hardware_concurrency()));
+    }
+
+    workspaces.resize(threads);
+}
+
+int BatchSolver::number_of_threads() const
+{
+    return static_cast<int>(workspaces.size());
+}
+
+vector<BatchResult> BatchSolver::solve(
+    const vector<Board>& boards,
+    const function<void(const BatchResult&, const BatchProgress&)>& report)
+{
+    vector<BatchResult> results(boards.size());
+
+    // Build shared tables up front, once for each dimension, so workers only
+    // ever read them. Boards too large for a table fail on their own later.
+    if (options.heuristic == Heuristic::walking_distance) {
+        vector<bool> built(WalkingDistance::max_dimension + 1, false);
+        for (const Board& board : boards) {
+            int n = board.dimension();
+            if (n >= 2 && n <= WalkingDistance::max_dimension && !built[n]) {
+                WalkingDistance::table(n);
+                built[n] = true;
+            }
+        }
+    }
+
+    auto start = chrono::steady_clock::now();
+    atomic<size_t> next(0);
+    atomic<bool> failed(false);
+    size_t finished = 0;
+    mutex report_mutex;
+    exception_ptr error;
+
+    auto work = [&](Solver::Workspace& workspace) {
+        while (!failed) {
+            size_t i = next++;
+            if (i >= boards.size()) {
+                break;
+            }
+
+            try {
+                auto board_start = chrono::steady_clock::now();
+                Solver solver(boards[i], options, workspace);
+                chrono::duration<double> elapsed = chrono::steady_clock::now() - board_start;
+
+                BatchResult& result = results[i];
+                result.index = i;
+                result.solvable = solver.is_solvable();
+                result.min_moves = solver.min_moves();
+                result.moves = solver.solution_moves();
+                result.seconds = elapsed.count();
+
+                lock_guard<mutex> lock(report_mutex);
+                ++finished;
+                if (report) {
+                    chrono::duration<double> total = chrono::steady_clock::now() - start;
+                    BatchProgress progress{ finished, boards.size(), total.count(),
+                                            finished / max(total.count(), 1e-9) };
+                    report(result, progress);
+                }
+            }
+            catch (...) {
+                lock_guard<mutex> lock(report_mutex);
+                if (!error) {
+                    error = current_exception();
+                }
+                failed = true;
+            }
+        }
+    };
+
+    vector<thread> workers;
+    for (size_t t = 1; t < workspaces.size(); ++t) {
+        workers.emplace_back(work, ref(workspaces[t]));
+    }
+    work(workspaces[0]);
+    for (thread& worker : workers) {
+        worker.join();
+    }
+
+    if (error) {
+        rethrow_exception(error);
+    }
+
+    return results;
+}
+
+vector<Board> BatchSolver::read_boards(istream& in)
+{
+    vector<Board> boards;
+
+    int n;
+    while (in >> n) {
+        if (n < 2 || n > 128) {
+            throw invalid_argument("BatchSolver: board dimension should be within [2, 128]!");
+        }
+
+        vector<int> tiles(n * n);
+        vector<bool> seen(n * n, false);
+        for (int& tile : tiles) {
+            if (!(in >> tile)) {
+                throw invalid_argument("BatchSolver: board is missing tiles!");
+            }
+            if (tile < 0 || tile >= n * n || seen[tile]) {
+                throw invalid_argument("BatchSolver: tiles should be distinct and within [0, N^2 - 1]!");
+            }
+            seen[tile] = true;
+        }
+
+        boards.emplace_back(tiles);
+    }
+    if (!in.eof()) {
+        throw invalid_argument("BatchSolver: board dimension should be an integer!");
+    }
+
+    return boards;
+}
+
+vector<Board> BatchSolver::read_boards(const string& file_name)
+{
+    ifstream in(file_name);
+    if (!in) {
+        throw invalid_argument("BatchSolver: cannot open " + file_name + "!");
+    }
+
+    return read_boards(in);
+}
+
+#pragma endregion Batch Solver
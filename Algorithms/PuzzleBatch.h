@@ -0,0 +1,64 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <functional>
+#include "AStar.h"
+
+namespace PuzzleBoard
+{
+
+#pragma region Batch Solver
+
+    // Outcome of one board of a batch
+    struct BatchResult {
+        size_t index;        // Position of the board in the batch
+        bool solvable;
+        int min_moves;       // -1 if the board is not solvable
+        MoveSequence moves;  // Moves of the empty tile in a shortest solution
+        double seconds;      // Time spent solving this board
+    };
+
+    // Progress of a batch, taken when a board is finished
+    struct BatchProgress {
+        size_t finished;
+        size_t total;
+        double seconds;  // Time since the batch started
+        double puzzles_per_second;
+    };
+
+    // Solves many boards on a pool of worker threads.
+    // Each worker keeps its own search workspace from one board to the next,
+    // and heuristic tables are shared read-only between all of them.
+    // Only A* and bidirectional searches use the workspace. Parallel and
+    // external searches set up their own threads, sets or files for every
+    // board, so a batch of them gains nothing from reuse.
+    class BatchSolver {
+    public:
+        // Solve every board with options on `threads` workers, or one per
+        // hardware thread if threads is 0. options.threads is only used by
+        // parallel searches, each of which runs on that many threads of its own.
+        BatchSolver(const SolverOptions& options = SolverOptions(), int threads = 0);
+
+        // Solve all boards and return their results in input order.
+        // report is called after each board, by one worker at a time.
+        std::vector<BatchResult> solve(
+            const std::vector<Board>& boards,
+            const std::function<void(const BatchResult&, const BatchProgress&)>& report = nullptr);
+
+        // Read boards written one after another in the format of
+        // Board::string_representation()
+        static std::vector<Board> read_boards(std::istream& in);
+        static std::vector<Board> read_boards(const std::string& file_name);
+
+        int number_of_threads() const;
+
+    private:
+        const SolverOptions options;
+        std::vector<Solver::Workspace> workspaces;  // One for each worker
+    };
+
+#pragma endregion Batch Solver
+
+}
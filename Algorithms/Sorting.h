@@ -278,6 +278,44 @@ namespace Sorting
         }
     }
 
+    // Return the number of pairs i < j within [lo, hi] where c[i] > c[j].
+    // Values should be integers within [0, max_value].
+    // Small ranges are counted pair by pair, large ones with a Fenwick tree
+    // of seen values in O(n log(max_value)) time.
+    template <class Container>
+    long long count_inversions(const Container& c, int lo, int hi, int max_value)
+    {
+        long long inversions = 0;
+
+        if (hi - lo < 32) {
+            for (int i = lo; i <= hi; ++i) {
+                for (int j = i + 1; j <= hi; ++j) {
+                    if (c[j] < c[i]) {
+                        ++inversions;
+                    }
+                }
+            }
+            return inversions;
+        }
+
+        // tree[k] counts seen values within (k - lowbit(k), k], shifted by 1
+        std::vector<int> tree(max_value + 2, 0);
+        for (int i = lo; i <= hi; ++i) {
+            // Seen values greater than c[i] are inversions with c[i]
+            int not_greater = 0;
+            for (int k = static_cast<int>(c[i]) + 1; k > 0; k -= k & -k) {
+                not_greater += tree[k];
+            }
+            inversions += (i - lo) - not_greater;
+
+            for (int k = static_cast<int>(c[i]) + 1; k <= max_value + 1; k += k & -k) {
+                ++tree[k];
+            }
+        }
+
+        return inversions;
+    }
+
     // A priority queue that uses a binary heap to store elements of type T,
     // and can pop out the minimum element.
     template <class T>
@@ -308,6 +346,17 @@ namespace Sorting
             return heap.empty();
         }
 
+        int size() const
+        {
+            return static_cast<int>(heap.size());
+        }
+
+        // Remove all elements, but keep the capacity of the heap
+        void clear()
+        {
+            heap.clear();
+        }
+
     private:
         std::vector<T> heap;
 
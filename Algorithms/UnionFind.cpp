@@ -3,7 +3,14 @@
 #include <string>
 #include <chrono>
 #include <random>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <exception>
 #include <math.h>
+#if defined(_MSC_VER)
+#include <xmmintrin.h>
+#endif
 
 #include "UnionFind.h"
 
@@ -80,15 +87,629 @@ void WeightedQuickUnion::connect(int a, int b)
     }
 }
 
+void WeightedQuickUnion::reset()
+{
+    for (int i = 0; i < N; ++i) {
+        root[i] = i;
+        size[i] = 1;
+    }
+}
+
+FrozenConnectivity WeightedQuickUnion::freeze()
+{
+    vector<int64_t> roots(N);
+    for (int i = 0; i < N; ++i) {
+        roots[i] = get_root(i);
+    }
+
+    return FrozenConnectivity(move(roots));
+}
+
 #pragma endregion Implementation
 
 
+#pragma region Compact
+
+CompactUnionFind::CompactUnionFind(int64_t n) : N(n)
+{
+    if (n <= 0) {
+        throw invalid_argument("UnionFind: n should be positive!");
+    }
+
+    // Every node starts as the root of a tree of size 1
+    parent.assign(static_cast<size_t>(N), -1);
+}
+
+int64_t CompactUnionFind::find(int64_t i)
+{
+    if (i < 0 || i > N - 1) {
+        throw invalid_argument("UnionFind: argument should be within [0, N - 1]!");
+    }
+
+    return find_unchecked(i);
+}
+
+bool CompactUnionFind::is_connected(int64_t a, int64_t b)
+{
+    if (a < 0 || a > N - 1 || b < 0 || b > N - 1) {
+        throw invalid_argument("UnionFind: argument should be within [0, N - 1]!");
+    }
+
+    return is_connected_unchecked(a, b);
+}
+
+void CompactUnionFind::connect(int64_t a, int64_t b)
+{
+    if (a < 0 || a > N - 1 || b < 0 || b > N - 1) {
+        throw invalid_argument("UnionFind: argument should be within [0, N - 1]!");
+    }
+
+    connect_unchecked(a, b);
+}
+
+int64_t CompactUnionFind::size() const
+{
+    return N;
+}
+
+int64_t CompactUnionFind::component_size(int64_t i)
+{
+    return -parent[find(i)];
+}
+
+void CompactUnionFind::reset()
+{
+    fill(parent.begin(), parent.end(), -1);
+}
+
+FrozenConnectivity CompactUnionFind::freeze()
+{
+    vector<int64_t> roots(static_cast<size_t>(N));
+    for (int64_t i = 0; i < N; ++i) {
+        roots[i] = find_unchecked(i);
+    }
+
+    return FrozenConnectivity(move(roots));
+}
+
+namespace
+{
+    // Pairs ahead of the current one whose parents are prefetched. Far
+    // enough for the loads to land, near enough to stay in cache.
+    const size_t prefetch_distance = 8;
+
+    void prefetch(const void* address)
+    {
+#if defined(_MSC_VER)
+        _mm_prefetch(static_cast<const char*>(address), _MM_HINT_T0);
+#else
+        __builtin_prefetch(address);
+#endif
+    }
+
+    // Copy of the pairs grouped by their smaller node, and the place of
+    // each in the input if position is not null. A counting sort into at
+    // most locality_buckets buckets does it in linear time, and writes to
+    // few enough places at once to stay in cache.
+    const uint64_t locality_buckets = 4096;
+
+    vector<NodePair> sorted_by_locality(const vector<NodePair>& pairs, int64_t n, vector<size_t>* position)
+    {
+        int shift = 0;
+        while (static_cast<uint64_t>(n - 1) >> shift >= locality_buckets) {
+            ++shift;
+        }
+        auto bucket = [&](const NodePair& pair) {
+            return static_cast<size_t>(min(pair.a, pair.b) >> shift);
+        };
+
+        vector<size_t> start(static_cast<size_t>((n - 1) >> shift) + 2, 0);
+        for (const NodePair& pair : pairs) {
+            ++start[bucket(pair) + 1];
+        }
+        for (size_t i = 1; i < start.size(); ++i) {
+            start[i] += start[i - 1];
+        }
+
+        vector<NodePair> sorted(pairs.size());
+        if (position) {
+            position->resize(pairs.size());
+        }
+        for (size_t i = 0; i < pairs.size(); ++i) {
+            size_t to = start[bucket(pairs[i])]++;
+            sorted[to] = pairs[i];
+            if (position) {
+                (*position)[to] = i;
+            }
+        }
+
+        return sorted;
+    }
+}
+
+void CompactUnionFind::connect_batch(const vector<NodePair>& pairs, bool sort_by_locality)
+{
+    for (const NodePair& pair : pairs) {
+        if (pair.a < 0 || pair.a > N - 1 || pair.b < 0 || pair.b > N - 1) {
+            throw invalid_argument("UnionFind: argument should be within [0, N - 1]!");
+        }
+    }
+
+    // Connections can be made in any order
+    vector<NodePair> sorted;
+    if (sort_by_locality) {
+        sorted = sorted_by_locality(pairs, N, nullptr);
+    }
+    const vector<NodePair>& batch = sort_by_locality ? sorted : pairs;
+
+    size_t count = batch.size();
+    for (size_t i = 0; i < count; ++i) {
+        if (i + prefetch_distance < count) {
+            prefetch(&parent[batch[i + prefetch_distance].a]);
+            prefetch(&parent[batch[i + prefetch_distance].b]);
+        }
+        connect_unchecked(batch[i].a, batch[i].b);
+    }
+}
+
+Bitmap CompactUnionFind::is_connected_batch(const vector<NodePair>& pairs, bool sort_by_locality)
+{
+    for (const NodePair& pair : pairs) {
+        if (pair.a < 0 || pair.a > N - 1 || pair.b < 0 || pair.b > N - 1) {
+            throw invalid_argument("UnionFind: argument should be within [0, N - 1]!");
+        }
+    }
+
+    vector<NodePair> sorted;
+    vector<size_t> position;
+    if (sort_by_locality) {
+        sorted = sorted_by_locality(pairs, N, &position);
+    }
+    const vector<NodePair>& batch = sort_by_locality ? sorted : pairs;
+
+    Bitmap result;
+    result.count = pairs.size();
+    result.words.assign((pairs.size() + 63) / 64, 0);
+
+    size_t count = batch.size();
+    for (size_t i = 0; i < count; ++i) {
+        if (i + prefetch_distance < count) {
+            prefetch(&parent[batch[i + prefetch_distance].a]);
+            prefetch(&parent[batch[i + prefetch_distance].b]);
+        }
+        if (is_connected_unchecked(batch[i].a, batch[i].b)) {
+            size_t query = sort_by_locality ? position[i] : i;
+            result.words[query >> 6] |= uint64_t(1) << (query & 63);
+        }
+    }
+
+    return result;
+}
+
+#pragma endregion Compact
+
+
+#pragma region Concurrent
+
+namespace
+{
+    // Mix the bits of a number, the way splitmix64 does, into a value that
+    // looks random but is the same on every run
+    uint64_t mix_bits(uint64_t x)
+    {
+        x += 0x9E3779B97F4A7C15ull;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    }
+}
+
+ConcurrentUnionFind::ConcurrentUnionFind(int64_t n)
+    : N(n), components(n)
+{
+    if (n <= 0) {
+        throw invalid_argument("UnionFind: n should be positive!");
+    }
+
+    parent.reset(new atomic<int64_t>[static_cast<size_t>(N)]);
+    for (int64_t i = 0; i < N; ++i) {
+        parent[i].store(i, memory_order_relaxed);
+    }
+}
+
+int64_t ConcurrentUnionFind::find(int64_t i)
+{
+    if (i < 0 || i > N - 1) {
+        throw invalid_argument("UnionFind: argument should be within [0, N - 1]!");
+    }
+
+    return find_root(i);
+}
+
+bool ConcurrentUnionFind::is_connected(int64_t a, int64_t b)
+{
+    if (a < 0 || a > N - 1 || b < 0 || b > N - 1) {
+        throw invalid_argument("UnionFind: argument should be within [0, N - 1]!");
+    }
+
+    while (true) {
+        a = find_root(a);
+        b = find_root(b);
+        if (a == b) {
+            return true;
+        }
+        // If a is still a root, a and b were apart when b was found
+        if (parent[a].load(memory_order_acquire) == a) {
+            return false;
+        }
+    }
+}
+
+void ConcurrentUnionFind::connect(int64_t a, int64_t b)
+{
+    if (a < 0 || a > N - 1 || b < 0 || b > N - 1) {
+        throw invalid_argument("UnionFind: argument should be within [0, N - 1]!");
+    }
+
+    while (true) {
+        a = find_root(a);
+        b = find_root(b);
+        if (a == b) {
+            return;
+        }
+        if (is_linked_before(b, a)) {
+            swap(a, b);
+        }
+
+        // Link a under b, unless another thread has linked a meanwhile
+        int64_t expected = a;
+        if (parent[a].compare_exchange_strong(expected, b, memory_order_acq_rel)) {
+            components.fetch_sub(1, memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+int64_t ConcurrentUnionFind::size() const
+{
+    return N;
+}
+
+int64_t ConcurrentUnionFind::count() const
+{
+    return components.load(memory_order_relaxed);
+}
+
+FrozenConnectivity ConcurrentUnionFind::freeze()
+{
+    vector<int64_t> roots(static_cast<size_t>(N));
+    for (int64_t i = 0; i < N; ++i) {
+        roots[i] = find_root(i);
+    }
+
+    return FrozenConnectivity(move(roots));
+}
+
+int64_t ConcurrentUnionFind::find_root(int64_t i)
+{
+    while (true) {
+        int64_t p = parent[i].load(memory_order_acquire);
+        if (p == i) {
+            return i;
+        }
+        int64_t grandparent = parent[p].load(memory_order_acquire);
+        if (grandparent == p) {
+            return p;
+        }
+
+        // Path halving. Failing is harmless, another thread moved i closer
+        // to its root already.
+        parent[i].compare_exchange_weak(p, grandparent, memory_order_acq_rel);
+        i = grandparent;
+    }
+}
+
+bool ConcurrentUnionFind::is_linked_before(int64_t a, int64_t b) const
+{
+    // Roots are ordered at random, but the same way on every run
+    uint64_t x = mix_bits(static_cast<uint64_t>(a));
+    uint64_t y = mix_bits(static_cast<uint64_t>(b));
+    return x < y || (x == y && a < b);
+}
+
+#pragma endregion Concurrent
+
+
+#pragma region Frozen
+
+FrozenConnectivity::FrozenConnectivity(vector<int64_t> roots)
+    : label(move(roots))
+{
+    // Give each root the next label the first time one of its nodes comes
+    // up. Roots are nodes too, so their labels go in a separate array.
+    int64_t n = static_cast<int64_t>(label.size());
+    vector<int64_t> root_label(label.size(), -1);
+    for (int64_t i = 0; i < n; ++i) {
+        int64_t root = label[i];
+        if (root < 0 || root > n - 1) {
+            throw invalid_argument("FrozenConnectivity: roots should be within [0, N - 1]!");
+        }
+        if (root_label[root] < 0) {
+            root_label[root] = static_cast<int64_t>(sizes.size());
+            sizes.push_back(0);
+        }
+        label[i] = root_label[root];
+        ++sizes[label[i]];
+    }
+}
+
+bool FrozenConnectivity::same_component(int64_t a, int64_t b) const
+{
+    check(a);
+    check(b);
+    return label[a] == label[b];
+}
+
+int64_t FrozenConnectivity::component(int64_t i) const
+{
+    check(i);
+    return label[i];
+}
+
+int64_t FrozenConnectivity::component_size(int64_t i) const
+{
+    check(i);
+    return sizes[label[i]];
+}
+
+int64_t FrozenConnectivity::size() const
+{
+    return static_cast<int64_t>(label.size());
+}
+
+int64_t FrozenConnectivity::number_of_components() const
+{
+    return static_cast<int64_t>(sizes.size());
+}
+
+const vector<int64_t>& FrozenConnectivity::labels() const
+{
+    return label;
+}
+
+void FrozenConnectivity::check(int64_t i) const
+{
+    if (i < 0 || i > size() - 1) {
+        throw invalid_argument("FrozenConnectivity: argument should be within [0, N - 1]!");
+    }
+}
+
+#pragma endregion Frozen
+
+
+#pragma region Rollback
+
+RollbackUnionFind::RollbackUnionFind(int64_t n)
+    : N(n), components(n)
+{
+    if (n <= 0) {
+        throw invalid_argument("UnionFind: n should be positive!");
+    }
+
+    parent.assign(static_cast<size_t>(N), -1);
+}
+
+int64_t RollbackUnionFind::find(int64_t i) const
+{
+    if (i < 0 || i > N - 1) {
+        throw invalid_argument("UnionFind: argument should be within [0, N - 1]!");
+    }
+
+    return root_of(i);
+}
+
+bool RollbackUnionFind::is_connected(int64_t a, int64_t b) const
+{
+    if (a < 0 || a > N - 1 || b < 0 || b > N - 1) {
+        throw invalid_argument("UnionFind: argument should be within [0, N - 1]!");
+    }
+
+    return root_of(a) == root_of(b);
+}
+
+bool RollbackUnionFind::connect(int64_t a, int64_t b)
+{
+    if (a < 0 || a > N - 1 || b < 0 || b > N - 1) {
+        throw invalid_argument("UnionFind: argument should be within [0, N - 1]!");
+    }
+
+    int64_t i = root_of(a);
+    int64_t j = root_of(b);
+    if (i == j) {
+        return false;
+    }
+
+    // Link the smaller tree j under i, remembering j's size to undo it
+    if (parent[i] > parent[j]) {
+        swap(i, j);
+    }
+    history.push_back(Change{ j, parent[j] });
+    parent[i] += parent[j];
+    parent[j] = i;
+    --components;
+    return true;
+}
+
+int64_t RollbackUnionFind::snapshot() const
+{
+    return static_cast<int64_t>(history.size());
+}
+
+void RollbackUnionFind::rollback(int64_t snapshot)
+{
+    if (snapshot < 0 || snapshot > static_cast<int64_t>(history.size())) {
+        throw invalid_argument("RollbackUnionFind: snapshot is newer than the current state!");
+    }
+
+    while (static_cast<int64_t>(history.size()) > snapshot) {
+        const Change& change = history.back();
+        int64_t i = parent[change.child];
+        parent[i] -= change.child_entry;
+        parent[change.child] = change.child_entry;
+        ++components;
+        history.pop_back();
+    }
+}
+
+int64_t RollbackUnionFind::size() const
+{
+    return N;
+}
+
+int64_t RollbackUnionFind::count() const
+{
+    return components;
+}
+
+int64_t RollbackUnionFind::root_of(int64_t i) const
+{
+    while (parent[i] >= 0) {
+        i = parent[i];
+    }
+    return i;
+}
+
+
+DynamicConnectivity::DynamicConnectivity(int64_t n) : N(n)
+{
+    if (n <= 0) {
+        throw invalid_argument("DynamicConnectivity: n should be positive!");
+    }
+}
+
+void DynamicConnectivity::add(int64_t a, int64_t b)
+{
+    check(a, b);
+    live[make_pair(min(a, b), max(a, b))].push_back(static_cast<int64_t>(queries.size()));
+}
+
+void DynamicConnectivity::remove(int64_t a, int64_t b)
+{
+    check(a, b);
+
+    auto edge = live.find(make_pair(min(a, b), max(a, b)));
+    if (edge == live.end()) {
+        throw invalid_argument("DynamicConnectivity: removed edge is not in the graph!");
+    }
+
+    // Parallel edges are interchangeable, so end the latest one
+    int64_t first_query = edge->second.back();
+    int64_t last_query = static_cast<int64_t>(queries.size());
+    if (first_query < last_query) {
+        intervals.push_back(Interval{ NodePair{ edge->first.first, edge->first.second }, first_query, last_query });
+    }
+    edge->second.pop_back();
+    if (edge->second.empty()) {
+        live.erase(edge);
+    }
+}
+
+void DynamicConnectivity::query(int64_t a, int64_t b)
+{
+    check(a, b);
+    queries.push_back(NodePair{ a, b });
+}
+
+namespace
+{
+    // Segment tree over the queries. Node k covers queries lo to hi - 1,
+    // and its children 2k and 2k + 1 cover the two halves. An edge is kept
+    // in the highest nodes that its queries cover completely.
+    struct EdgeTree {
+        std::vector<std::vector<NodePair>> edges;
+
+        void insert(int64_t k, int64_t lo, int64_t hi, int64_t first, int64_t last, const NodePair& edge)
+        {
+            if (last <= lo || hi <= first) {
+                return;
+            }
+            if (first <= lo && hi <= last) {
+                edges[k].push_back(edge);
+                return;
+            }
+            int64_t mid = (lo + hi) / 2;
+            insert(2 * k, lo, mid, first, last, edge);
+            insert(2 * k + 1, mid, hi, first, last, edge);
+        }
+
+        // Connect the edges of node k, answer its queries, then undo
+        void answer(int64_t k, int64_t lo, int64_t hi, const vector<NodePair>& queries,
+                    RollbackUnionFind& uf, Bitmap& answers) const
+        {
+            int64_t snapshot = uf.snapshot();
+            for (const NodePair& edge : edges[k]) {
+                uf.connect(edge.a, edge.b);
+            }
+
+            if (hi - lo == 1) {
+                if (uf.is_connected(queries[lo].a, queries[lo].b)) {
+                    answers.words[lo >> 6] |= uint64_t(1) << (lo & 63);
+                }
+            }
+            else {
+                int64_t mid = (lo + hi) / 2;
+                answer(2 * k, lo, mid, queries, uf, answers);
+                answer(2 * k + 1, mid, hi, queries, uf, answers);
+            }
+
+            uf.rollback(snapshot);
+        }
+    };
+}
+
+Bitmap DynamicConnectivity::solve() const
+{
+    int64_t q = static_cast<int64_t>(queries.size());
+    Bitmap answers;
+    answers.count = queries.size();
+    answers.words.assign((queries.size() + 63) / 64, 0);
+    if (q == 0) {
+        return answers;
+    }
+
+    // Edges still present last until after the final query
+    EdgeTree tree;
+    tree.edges.resize(static_cast<size_t>(4 * q));
+    for (const Interval& interval : intervals) {
+        tree.insert(1, 0, q, interval.first_query, interval.last_query, interval.edge);
+    }
+    for (const auto& edge : live) {
+        for (int64_t first_query : edge.second) {
+            tree.insert(1, 0, q, first_query, q, NodePair{ edge.first.first, edge.first.second });
+        }
+    }
+
+    RollbackUnionFind uf(N);
+    tree.answer(1, 0, q, queries, uf, answers);
+    return answers;
+}
+
+void DynamicConnectivity::check(int64_t a, int64_t b) const
+{
+    if (a < 0 || a > N - 1 || b < 0 || b > N - 1) {
+        throw invalid_argument("DynamicConnectivity: argument should be within [0, N - 1]!");
+    }
+}
+
+#pragma endregion Rollback
+
+
 #pragma region Percolation
 
 // Create two extra virtual sites at top and bottom
 Percolation::Percolation(int n)
     : N(n),
-      grid(WeightedQuickUnion(n* n + 2)),
+      grid(static_cast<int64_t>(n) * n + 2),
       open_status(new bool[n * n + 2])
 {
     if (n <= 0) {
@@ -104,9 +725,9 @@ Percolation::Percolation(int n)
 
     for (int i = 0; i < N; ++i) {
         // Connect virtual top site with each site in the first row
-        grid.connect(i, N * N);
+        grid.connect_unchecked(i, N * N);
         // Connect virtual bottom site with each site in the last row
-        grid.connect(N * N - 1 - i, N * N + 1);
+        grid.connect_unchecked(N * N - 1 - i, N * N + 1);
     }
 }
 
@@ -131,21 +752,23 @@ void Percolation::open(int row, int col)
     open_status[i] = true;
     open_sites_count += 1;
 
+    // Row and col are checked already, so neighbours are looked up and
+    // connected without checking them again.
     // Connect current site to its left site if that site is open
-    if (col > 1 && is_open(row, col - 1)) {
-        grid.connect(i, i - 1);
+    if (col > 1 && open_status[i - 1]) {
+        grid.connect_unchecked(i, i - 1);
     }
     // Right
-    if (col < N && is_open(row, col + 1)) {
-        grid.connect(i, i + 1);
+    if (col < N && open_status[i + 1]) {
+        grid.connect_unchecked(i, i + 1);
     }
     // Top
-    if (row > 1 && is_open(row - 1, col)) {
-        grid.connect(i, i - N);
+    if (row > 1 && open_status[i - N]) {
+        grid.connect_unchecked(i, i - N);
     }
     // Bottom
-    if (row < N && is_open(row + 1, col)) {
-        grid.connect(i, i + N);
+    if (row < N && open_status[i + N]) {
+        grid.connect_unchecked(i, i + N);
     }
 }
 
@@ -166,7 +789,7 @@ bool Percolation::is_full(int row, int col)
     }
 
     int i = (row - 1) * N + col - 1;
-    return grid.is_connected(i, N * N);
+    return grid.is_connected_unchecked(i, N * N);
 }
 
 int Percolation::number_of_open_sites() const
@@ -176,7 +799,48 @@ int Percolation::number_of_open_sites() const
 
 bool Percolation::percolates()
 {
-    return grid.is_connected(N * N, N * N + 1);
+    return grid.is_connected_unchecked(N * N, N * N + 1);
+}
+
+void Percolation::reset()
+{
+    grid.reset();
+    fill(open_status, open_status + N * N, false);
+    open_sites_count = 0;
+
+    for (int i = 0; i < N; ++i) {
+        grid.connect_unchecked(i, N * N);
+        grid.connect_unchecked(N * N - 1 - i, N * N + 1);
+    }
+}
+
+
+void RunningStats::add(double x)
+{
+    ++n;
+    double delta = x - m;
+    m += delta / n;
+    sum_of_squares += delta * (x - m);
+}
+
+int64_t RunningStats::count() const
+{
+    return n;
+}
+
+double RunningStats::mean() const
+{
+    return m;
+}
+
+double RunningStats::variance() const
+{
+    return n > 1 ? sum_of_squares / (n - 1) : 0.0;
+}
+
+double RunningStats::std_dev() const
+{
+    return sqrt(variance());
 }
 
 
@@ -190,54 +854,215 @@ PercolationStats::PercolationStats(int n, int t)
     run();
 }
 
+PercolationStats::PercolationStats(int n, int t, const PercolationOptions& options)
+    : N(n), T(t)
+{
+    if (n <= 0 || t <= 0) {
+        throw invalid_argument("PercolationStats: n and t should be positive!");
+    }
+    if (options.threads < 0) {
+        throw invalid_argument("PercolationStats: threads should not be negative!");
+    }
+
+    run(options);
+}
+
+PercolationStats::PercolationStats(int n, double half_width, int max_trials,
+                                   const PercolationOptions& options)
+    : N(n), T(max_trials)
+{
+    if (n <= 0 || max_trials <= 0) {
+        throw invalid_argument("PercolationStats: n and max_trials should be positive!");
+    }
+    if (half_width <= 0) {
+        throw invalid_argument("PercolationStats: half_width should be positive!");
+    }
+    if (options.threads < 0) {
+        throw invalid_argument("PercolationStats: threads should not be negative!");
+    }
+
+    run(half_width, options);
+}
+
 void PercolationStats::run()
 {
     cout << "Performing " << T << " trials on a " << N << "x" << N << " grid\n";
     cout << "This may take some time...\n\n";
 
-    thresholds.reserve(T);
+    Workspace workspace(N);
 
     // Run Monte-Carlo simulation T times
     for (int t = 0; t < T; ++t) {
-        // Initialise a percolation grid
-        Percolation grid(N);
-
-        // All sites are initially blocked
-        vector<int> blocked_sites;
-        blocked_sites.reserve(N * N);
-        for (int i = 0; i < N * N; ++i) {
-            blocked_sites.push_back(i);
-        }
-
-        // Initialise random number generator and shuffle the vector
-        // Note mt19937_64 might be needed if you test on really large N's
-        int seed = static_cast<int>(chrono::system_clock::now().time_since_epoch().count());
-        mt19937 generator(seed);
-        shuffle(blocked_sites.begin(), blocked_sites.end(), generator);
-
-        do {
-            // Randomly choose a blocked site at index i
-            uniform_int_distribution<int> distribution(0, blocked_sites.size() - 1);
-            int i = distribution(generator);
-
-            // Open that site
-            int row = blocked_sites[i] / N + 1;
-            int col = blocked_sites[i] % N + 1;
-            grid.open(row, col);
-
-            // Once the site is opened, remove it from the vector
-            swap(blocked_sites[i], blocked_sites.back());
-            blocked_sites.pop_back();
-        } while (!grid.percolates());  // Loop until the system percolates
-
-        // The percentage of open sites in the system is an estimate
-        // of the percolation threshold.
-        double threshold = static_cast<double>(grid.number_of_open_sites()) / N / N;
-        thresholds.push_back(threshold);
+        uint64_t seed = static_cast<uint64_t>(chrono::system_clock::now().time_since_epoch().count());
+        mt19937_64 generator(seed);
+        stats.add(trial(generator, workspace));
 
         cout << "Trial " << t + 1 << " finished\n";
     }
 
+    print_stats();
+}
+
+namespace
+{
+    int number_of_threads(const PercolationOptions& options)
+    {
+        if (options.threads == 0) {
+            return max(1, static_cast<int>(thread::hardware_concurrency()));
+        }
+        return options.threads;
+    }
+}
+
+void PercolationStats::run(const PercolationOptions& options)
+{
+    int threads = min(number_of_threads(options), T);
+
+    if (!options.quiet) {
+        cout << "Performing " << T << " trials on a " << N << "x" << N << " grid with "
+             << threads << (threads == 1 ? " thread\n\n" : " threads\n\n");
+    }
+
+    vector<unique_ptr<Workspace>> workspaces(threads);
+    run_batch(0, T, threads, options, workspaces);
+
+    if (!options.quiet) {
+        print_stats();
+    }
+}
+
+void PercolationStats::run(double half_width, const PercolationOptions& options)
+{
+    int threads = number_of_threads(options);
+
+    if (!options.quiet) {
+        cout << "Performing up to " << T << " trials on a " << N << "x" << N << " grid with "
+             << threads << (threads == 1 ? " thread" : " threads")
+             << ", until the 95% confidence interval is within " << half_width << " of the mean\n\n";
+    }
+
+    // The normal approximation behind the interval needs a few dozen trials.
+    // After that each batch aims at the trials the current deviation asks
+    // for, but at most doubles the count, as the early deviation is rough.
+    const int min_batch = 32;
+    vector<unique_ptr<Workspace>> workspaces(threads);
+    while (stats.count() < T) {
+        int done = static_cast<int>(stats.count());
+        int batch = min_batch;
+        if (done >= min_batch) {
+            if ((confidence_hi() - confidence_lo()) / 2 <= half_width) {
+                break;
+            }
+            double z = 1.96 * std_dev() / half_width;
+            double needed = min(z * z, static_cast<double>(T));
+            batch = max(min_batch, min(done, static_cast<int>(ceil(needed)) - done));
+        }
+        batch = min(batch, T - done);
+        run_batch(done, batch, threads, options, workspaces);
+    }
+
+    if (!options.quiet) {
+        print_stats();
+        cout << "Trials needed: " << number_of_trials() << '\n';
+    }
+}
+
+void PercolationStats::run_batch(int first, int count, int threads, const PercolationOptions& options,
+                                 vector<unique_ptr<Workspace>>& workspaces)
+{
+    threads = min(threads, count);
+    vector<double> thresholds(count);
+    atomic<int> next(0);
+    atomic<bool> failed(false);
+    mutex error_mutex;
+    exception_ptr error;
+
+    // Trials are taken in any order, but each one lands in its own slot
+    auto work = [&](unique_ptr<Workspace>& workspace) {
+        while (!failed) {
+            int i = next++;
+            if (i >= count) {
+                break;
+            }
+
+            try {
+                if (!workspace) {
+                    workspace.reset(new Workspace(N));
+                }
+                // A seed_seq takes longer than a small trial, so the seed of
+                // trial t is mixed from the master seed and t instead
+                uint64_t t = static_cast<uint64_t>(first) + i;
+                mt19937_64 generator(mix_bits(options.seed ^ mix_bits(t)));
+                thresholds[i] = trial(generator, *workspace);
+                if (options.progress) {
+                    options.progress->fetch_add(1, memory_order_relaxed);
+                }
+            }
+            catch (...) {
+                lock_guard<mutex> lock(error_mutex);
+                if (!error) {
+                    error = current_exception();
+                }
+                failed = true;
+            }
+        }
+    };
+
+    vector<thread> workers;
+    for (int i = 1; i < threads; ++i) {
+        workers.emplace_back(work, ref(workspaces[i]));
+    }
+    work(workspaces[0]);
+    for (thread& worker : workers) {
+        worker.join();
+    }
+
+    if (error) {
+        rethrow_exception(error);
+    }
+
+    // Adding in trial order keeps the stats the same for any thread count
+    for (double threshold : thresholds) {
+        stats.add(threshold);
+    }
+}
+
+double PercolationStats::trial(mt19937_64& generator, Workspace& workspace) const
+{
+    // Start from a blocked grid, reusing the arrays of the last trial
+    Percolation& grid = workspace.grid;
+    grid.reset();
+
+    // All sites are initially blocked
+    vector<int>& blocked_sites = workspace.blocked_sites;
+    blocked_sites.resize(N * N);
+    for (int i = 0; i < N * N; ++i) {
+        blocked_sites[i] = i;
+    }
+    shuffle(blocked_sites.begin(), blocked_sites.end(), generator);
+
+    do {
+        // Randomly choose a blocked site at index i
+        uniform_int_distribution<int> distribution(0, blocked_sites.size() - 1);
+        int i = distribution(generator);
+
+        // Open that site
+        int row = blocked_sites[i] / N + 1;
+        int col = blocked_sites[i] % N + 1;
+        grid.open(row, col);
+
+        // Once the site is opened, remove it from the vector
+        swap(blocked_sites[i], blocked_sites.back());
+        blocked_sites.pop_back();
+    } while (!grid.percolates());  // Loop until the system percolates
+
+    // The percentage of open sites in the system is an estimate
+    // of the percolation threshold.
+    return static_cast<double>(grid.number_of_open_sites()) / N / N;
+}
+
+void PercolationStats::print_stats() const
+{
     // Print out some useful stats
     cout << "\nTrial finished, stats about simulated percolation threshold:\n\n";
     cout << "Mean: " << mean() << '\n';
@@ -246,38 +1071,282 @@ void PercolationStats::run()
     cout << "High end of 95% confidence interval: " << confidence_hi() << '\n';
 }
 
+int PercolationStats::number_of_trials() const
+{
+    return static_cast<int>(stats.count());
+}
+
 double PercolationStats::mean() const
 {
-    double sum = 0.0;
-    for (double threshold : thresholds) {
-        sum += threshold;
-    }
-    return sum / T;
+    return stats.mean();
 }
 
 double PercolationStats::std_dev() const
 {
-    double s_squared = 0.0;
-    double m = mean();
-    for (double threshold : thresholds) {
-        s_squared += (threshold - m) * (threshold - m);
-    }
-    s_squared /= static_cast<double>(T) - 1;
-    return sqrt(s_squared);
+    return stats.std_dev();
 }
 
 double PercolationStats::confidence_lo() const
 {
-    double m = mean();
-    double s = std_dev();
-    return m - (1.96 * s) / sqrt(T);
+    return mean() - (1.96 * std_dev()) / sqrt(static_cast<double>(stats.count()));
 }
 
 double PercolationStats::confidence_hi() const
 {
-    double m = mean();
-    double s = std_dev();
-    return m + (1.96 * s) / sqrt(T);
+    return mean() + (1.96 * std_dev()) / sqrt(static_cast<double>(stats.count()));
 }
 
 #pragma endregion Percolation
+
+
+#pragma region Large Percolation
+
+// Padding tiles past the edge of the grid hold nodes that never open.
+// The two virtual sites come after all tiles.
+LargePercolation::LargePercolation(int64_t n)
+    : N(n),
+      tiles_per_row(n > 0 ? (n + tile_size - 1) / tile_size : 0),
+      top(tiles_per_row * tiles_per_row * tile_size * tile_size),
+      bottom(top + 1),
+      grid(top + 2)
+{
+    if (n <= 0) {
+        throw invalid_argument("Percolation: n should be positive!");
+    }
+
+    open_bits.assign(static_cast<size_t>(tiles_per_row * tiles_per_row), 0);
+}
+
+void LargePercolation::open(int64_t row, int64_t col)
+{
+    if (row < 1 || row > N || col < 1 || col > N) {
+        throw invalid_argument("Percolation: row and col should be within [1, N]!");
+    }
+
+    --row;
+    --col;
+    int64_t i = index(row, col);
+    if (is_open_at(i)) {
+        return;
+    }
+    open_bits[i >> (2 * tile_bits)] |= uint64_t(1) << (i & 63);
+    open_sites_count += 1;
+
+    if (row == 0) {
+        grid.connect_unchecked(i, top);
+    }
+    if (row == N - 1) {
+        grid.connect_unchecked(i, bottom);
+    }
+
+    // Left and right neighbours inside the tile are one bit away, and the
+    // top and bottom ones tile_size bits away
+    if (col > 0) {
+        int64_t j = (col & (tile_size - 1)) ? i - 1 : index(row, col - 1);
+        if (is_open_at(j)) {
+            grid.connect_unchecked(i, j);
+        }
+    }
+    if (col < N - 1) {
+        int64_t j = ((col + 1) & (tile_size - 1)) ? i + 1 : index(row, col + 1);
+        if (is_open_at(j)) {
+            grid.connect_unchecked(i, j);
+        }
+    }
+    if (row > 0) {
+        int64_t j = (row & (tile_size - 1)) ? i - tile_size : index(row - 1, col);
+        if (is_open_at(j)) {
+            grid.connect_unchecked(i, j);
+        }
+    }
+    if (row < N - 1) {
+        int64_t j = ((row + 1) & (tile_size - 1)) ? i + tile_size : index(row + 1, col);
+        if (is_open_at(j)) {
+            grid.connect_unchecked(i, j);
+        }
+    }
+}
+
+bool LargePercolation::is_open(int64_t row, int64_t col) const
+{
+    if (row < 1 || row > N || col < 1 || col > N) {
+        throw invalid_argument("Percolation: row and col should be within [1, N]!");
+    }
+
+    return is_open_at(index(row - 1, col - 1));
+}
+
+bool LargePercolation::is_full(int64_t row, int64_t col)
+{
+    if (row < 1 || row > N || col < 1 || col > N) {
+        throw invalid_argument("Percolation: row and col should be within [1, N]!");
+    }
+
+    int64_t i = index(row - 1, col - 1);
+    return is_open_at(i) && grid.is_connected_unchecked(i, top);
+}
+
+int64_t LargePercolation::number_of_open_sites() const
+{
+    return open_sites_count;
+}
+
+bool LargePercolation::percolates()
+{
+    return grid.is_connected_unchecked(top, bottom);
+}
+
+#pragma endregion Large Percolation
+
+
+#pragma region Newman-Ziff
+
+namespace
+{
+    const uint8_t open_flag = 1;
+    const uint8_t top_flag = 2;     // The cluster touches the top row
+    const uint8_t bottom_flag = 4;  // The cluster touches the bottom row
+}
+
+NewmanZiff::NewmanZiff(int n)
+    : N(n),
+      sites(static_cast<int64_t>(n) * n),
+      grid(n > 0 ? static_cast<int64_t>(n) * n : 1)
+{
+    if (n <= 0) {
+        throw invalid_argument("NewmanZiff: n should be positive!");
+    }
+
+    order.resize(static_cast<size_t>(sites));
+    for (int64_t i = 0; i < sites; ++i) {
+        order[i] = i;
+    }
+    state.resize(static_cast<size_t>(sites));
+    percolated.resize(static_cast<size_t>(sites + 1));
+    largest_total.resize(static_cast<size_t>(sites + 1));
+}
+
+double NewmanZiff::sweep(mt19937_64& generator)
+{
+    grid.reset();
+    fill(state.begin(), state.end(), 0);
+
+    // Shuffling the previous order is as random as shuffling a fresh one
+    shuffle(order.begin(), order.end(), generator);
+
+    int64_t largest = 0;
+    int64_t threshold = 0;  // Open sites when the grid first percolated
+    for (int64_t k = 1; k <= sites; ++k) {
+        int64_t i = order[k - 1];
+        int64_t row = i / N;
+        int64_t col = i % N;
+
+        uint8_t flags = open_flag;
+        if (row == 0) {
+            flags |= top_flag;
+        }
+        if (row == N - 1) {
+            flags |= bottom_flag;
+        }
+
+        // Merge the flags of every open neighbour's cluster into the new one
+        const int64_t neighbours[] = {
+            col > 0 ? i - 1 : -1,
+            col < N - 1 ? i + 1 : -1,
+            row > 0 ? i - N : -1,
+            row < N - 1 ? i + N : -1,
+        };
+        for (int64_t j : neighbours) {
+            if (j >= 0 && state[j]) {
+                flags |= state[grid.find_unchecked(j)];
+                grid.connect_unchecked(i, j);
+            }
+        }
+
+        int64_t root = grid.find_unchecked(i);
+        state[i] = open_flag;
+        state[root] = flags;
+        largest = max(largest, grid.component_size_unchecked(root));
+        if (threshold == 0 && (flags & (top_flag | bottom_flag)) == (top_flag | bottom_flag)) {
+            threshold = k;
+        }
+
+        largest_total[k] += largest;
+        percolated[k] += threshold != 0;
+    }
+
+    ++sweeps;
+    return static_cast<double>(threshold) / sites;
+}
+
+int64_t NewmanZiff::number_of_sweeps() const
+{
+    return sweeps;
+}
+
+PercolationPoint NewmanZiff::at(double p) const
+{
+    if (p < 0.0 || p > 1.0) {
+        throw invalid_argument("NewmanZiff: p should be within [0, 1]!");
+    }
+    if (sweeps == 0) {
+        throw invalid_argument("NewmanZiff: no sweeps yet!");
+    }
+
+    double percolating = 0.0;
+    double largest = 0.0;
+    double total_weight = 0.0;
+    auto add = [&](int64_t k, double weight) {
+        percolating += weight * percolated[k];
+        largest += weight * largest_total[k];
+        total_weight += weight;
+    };
+
+    if (p == 0.0 || p == 1.0) {
+        add(p == 0.0 ? 0 : sites, 1.0);
+    }
+    else {
+        // Start at the most likely number of open sites and walk outwards,
+        // getting each binomial weight from its neighbour, until the weights
+        // no longer count. Rounding errors are divided out by the total.
+        int64_t mode = min(sites, static_cast<int64_t>((sites + 1) * p));
+        double log_weight = lgamma(sites + 1.0) - lgamma(mode + 1.0) - lgamma(sites - mode + 1.0)
+                          + mode * log(p) + (sites - mode) * log1p(-p);
+        double peak = exp(log_weight);
+        double odds = p / (1.0 - p);
+        const double cutoff = 1e-16 * peak;
+
+        add(mode, peak);
+        double weight = peak;
+        for (int64_t k = mode; k < sites && weight > cutoff; ++k) {
+            weight *= odds * (sites - k) / (k + 1);
+            add(k + 1, weight);
+        }
+        weight = peak;
+        for (int64_t k = mode; k > 0 && weight > cutoff; --k) {
+            weight *= k / (odds * (sites - k + 1));
+            add(k - 1, weight);
+        }
+    }
+
+    percolating /= total_weight;
+    largest /= total_weight;
+    return PercolationPoint{ p, percolating / sweeps, largest / sweeps / sites };
+}
+
+vector<PercolationPoint> NewmanZiff::curve(int points) const
+{
+    if (points < 2) {
+        throw invalid_argument("NewmanZiff: a curve needs at least 2 points!");
+    }
+
+    vector<PercolationPoint> result;
+    result.reserve(points);
+    for (int i = 0; i < points; ++i) {
+        result.push_back(at(static_cast<double>(i) / (points - 1)));
+    }
+
+    return result;
+}
+
+#pragma endregion Newman-Ziff
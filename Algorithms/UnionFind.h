@@ -1,9 +1,17 @@
 #pragma once
 
 #include <vector>
+#include <map>
+#include <memory>
+#include <atomic>
+#include <random>
+#include <utility>
+#include <stdint.h>
+#include <assert.h>
 
 namespace UnionFind
 {
+    class FrozenConnectivity;
 
 #pragma region Implementaion
 
@@ -18,6 +26,12 @@ namespace UnionFind
         bool is_connected(int a, int b);
         void connect(int a, int b);
 
+        // Split every node into its own tree again, keeping the arrays
+        void reset();
+
+        // Read-only copy of the components, see FrozenConnectivity
+        FrozenConnectivity freeze();
+
     private:
         const int N;
         int* root;  // An array that stores the root of each node
@@ -28,6 +42,256 @@ namespace UnionFind
 #pragma endregion Implementation
 
 
+#pragma region Compact
+
+    // Two nodes to connect, or to ask about
+    struct NodePair {
+        int64_t a;
+        int64_t b;
+    };
+
+    // One bit per query, bit i of words[i / 64] for query i
+    struct Bitmap {
+        std::vector<uint64_t> words;
+        size_t count = 0;
+
+        bool operator[](size_t i) const { return (words[i >> 6] >> (i & 63)) & 1; }
+        size_t size() const { return count; }
+    };
+
+    // Weighted quick union in a single array of 64-bit entries. A root
+    // stores minus the size of its tree, any other node stores its parent,
+    // so a find touches one entry per hop and nothing else.
+    // The checked functions throw on indices out of range, the unchecked
+    // ones only assert them in debug builds and are meant for callers that
+    // have validated their indices already.
+    class CompactUnionFind {
+    public:
+        CompactUnionFind(int64_t n);  // Creates a system of n nodes
+
+        int64_t find(int64_t i);
+        bool is_connected(int64_t a, int64_t b);
+        void connect(int64_t a, int64_t b);
+
+        int64_t find_unchecked(int64_t i)
+        {
+            assert(i >= 0 && i < N);
+
+            // Path halving: point every other node on the way at its grandparent
+            while (parent[i] >= 0) {
+                int64_t p = parent[i];
+                if (parent[p] < 0) {
+                    return p;
+                }
+                parent[i] = parent[p];
+                i = parent[p];
+            }
+
+            return i;
+        }
+
+        bool is_connected_unchecked(int64_t a, int64_t b)
+        {
+            return find_unchecked(a) == find_unchecked(b);
+        }
+
+        void connect_unchecked(int64_t a, int64_t b)
+        {
+            int64_t i = find_unchecked(a);
+            int64_t j = find_unchecked(b);
+            if (i == j) {
+                return;
+            }
+
+            // Sizes are negative, so the larger tree has the smaller entry
+            if (parent[i] > parent[j]) {
+                std::swap(i, j);
+            }
+            parent[i] += parent[j];
+            parent[j] = i;
+        }
+
+        // Number of nodes
+        int64_t size() const;
+
+        // Number of nodes in the tree of i
+        int64_t component_size(int64_t i);
+
+        int64_t component_size_unchecked(int64_t i)
+        {
+            return -parent[find_unchecked(i)];
+        }
+
+        // Split every node into its own tree again, keeping the array
+        void reset();
+
+        // Read-only copy of the components, see FrozenConnectivity
+        FrozenConnectivity freeze();
+
+        // Connect or ask about many pairs at once. Indices are checked in
+        // one pass before any change, then each pair is handled unchecked
+        // while the parents of pairs a few places ahead are prefetched.
+        // Sorting by locality first groups the pairs by their smaller node,
+        // so pairs handled together touch nearby parents. The grouping costs
+        // about as much as it saves on scattered batches, so measure before
+        // turning it on. Query results keep the input order.
+        void connect_batch(const std::vector<NodePair>& pairs, bool sort_by_locality = false);
+        Bitmap is_connected_batch(const std::vector<NodePair>& pairs, bool sort_by_locality = false);
+
+    private:
+        const int64_t N;
+        std::vector<int64_t> parent;  // Parent of each node, or minus the tree size at a root
+    };
+
+#pragma endregion Compact
+
+
+#pragma region Concurrent
+
+    // Union-find that many threads can update and query at once, without
+    // locks. Every node holds an atomic parent, and a root is its own parent.
+    // connect links one root under the other with a compare-and-swap, and
+    // starts over if another thread linked that root first. Roots are ordered
+    // by a fixed random priority of their index, which keeps the trees
+    // shallow without storing sizes. find never waits: it halves the path
+    // with compare-and-swaps that are allowed to fail, since every parent it
+    // could write is an ancestor anyway.
+    class ConcurrentUnionFind {
+    public:
+        ConcurrentUnionFind(int64_t n);  // Creates a system of n nodes
+
+        int64_t find(int64_t i);
+        bool is_connected(int64_t a, int64_t b);
+        void connect(int64_t a, int64_t b);
+
+        // Number of nodes
+        int64_t size() const;
+
+        // Number of components. Exact once no connect is running.
+        int64_t count() const;
+
+        // Read-only copy of the components, see FrozenConnectivity.
+        // Call it once no connect is running.
+        FrozenConnectivity freeze();
+
+    private:
+        const int64_t N;
+        std::unique_ptr<std::atomic<int64_t>[]> parent;
+        std::atomic<int64_t> components;
+
+        int64_t find_root(int64_t i);
+        bool is_linked_before(int64_t a, int64_t b) const;  // Does root a go under root b?
+    };
+
+#pragma endregion Concurrent
+
+
+#pragma region Frozen
+
+    // Components of a finished union-find, flattened to one label per node.
+    // Labels run from 0 to number_of_components() - 1 in order of each
+    // component's first node. Queries only read, so any number of threads
+    // can make them at once, and each is a lookup or two.
+    class FrozenConnectivity {
+    public:
+        // Label nodes from the root of each node, in any union-find
+        explicit FrozenConnectivity(std::vector<int64_t> roots);
+
+        bool same_component(int64_t a, int64_t b) const;
+        int64_t component(int64_t i) const;       // Label of i
+        int64_t component_size(int64_t i) const;  // Number of nodes in the component of i
+
+        int64_t size() const;  // Number of nodes
+        int64_t number_of_components() const;
+
+        // Label of every node, in one buffer
+        const std::vector<int64_t>& labels() const;
+
+    private:
+        std::vector<int64_t> label;  // Label of each node
+        std::vector<int64_t> sizes;  // Size of each component
+
+        void check(int64_t i) const;
+    };
+
+#pragma endregion Frozen
+
+
+#pragma region Rollback
+
+    // Weighted quick union without path compression, so every connect can
+    // be undone. connect records what it changed, snapshot() marks a point
+    // in that record, and rollback() undoes everything after the mark.
+    // find takes O(log n) steps, as union by size keeps trees that low.
+    class RollbackUnionFind {
+    public:
+        RollbackUnionFind(int64_t n);  // Creates a system of n nodes
+
+        int64_t find(int64_t i) const;
+        bool is_connected(int64_t a, int64_t b) const;
+
+        // Return false if a and b were connected already, which records nothing
+        bool connect(int64_t a, int64_t b);
+
+        int64_t snapshot() const;           // Mark the current state
+        void rollback(int64_t snapshot);    // Go back to a marked state
+
+        int64_t size() const;   // Number of nodes
+        int64_t count() const;  // Number of components
+
+    private:
+        // A root that was linked under another root, and its entry before
+        struct Change {
+            int64_t child;
+            int64_t child_entry;
+        };
+
+        const int64_t N;
+        std::vector<int64_t> parent;  // Parent of each node, or minus the tree size at a root
+        std::vector<Change> history;
+        int64_t components;
+
+        int64_t root_of(int64_t i) const;
+    };
+
+    // Connectivity of a graph whose edges come and go, answered offline.
+    // Record the whole timeline of add, remove and query operations, then
+    // call solve(). Each edge lives over an interval of the timeline, which
+    // is split over the nodes of a segment tree on the queries. A depth
+    // first walk of the tree connects the edges of each node in a
+    // RollbackUnionFind on the way down, answers queries at the leaves and
+    // rolls back on the way up, in O((n + q) log n log q) overall.
+    class DynamicConnectivity {
+    public:
+        DynamicConnectivity(int64_t n);  // Creates a graph of n nodes and no edges
+
+        void add(int64_t a, int64_t b);     // Add an edge, parallel edges are allowed
+        void remove(int64_t a, int64_t b);  // Remove an edge added before
+        void query(int64_t a, int64_t b);   // Ask whether a and b are connected now
+
+        // Answer every query, bit i for query i
+        Bitmap solve() const;
+
+    private:
+        struct Interval {
+            NodePair edge;
+            int64_t first_query;  // Queries first_query to last_query - 1 see the edge
+            int64_t last_query;
+        };
+
+        const int64_t N;
+        std::vector<NodePair> queries;
+        std::vector<Interval> intervals;  // Edges removed already
+
+        // First query seen by each copy of each edge present now
+        std::map<std::pair<int64_t, int64_t>, std::vector<int64_t>> live;
+
+        void check(int64_t a, int64_t b) const;
+    };
+
+#pragma endregion Rollback
+
+
 #pragma region Percolation
 
     // Define a UnionFind grid to model a percolation system,
@@ -47,20 +311,67 @@ namespace UnionFind
         int number_of_open_sites() const;
         bool percolates();  // Does the system percolate?
 
+        // Block all sites again, keeping the arrays for the next trial
+        void reset();
+
     private:
         const int N;
-        WeightedQuickUnion grid;
+        CompactUnionFind grid;
         bool* open_status;  // An array that stores the open status of each site
         int open_sites_count = 0;
     };
 
+    // Mean and variance of a stream of samples, updated with Welford's
+    // method, which stays accurate without storing the samples
+    class RunningStats {
+    public:
+        void add(double x);
+
+        int64_t count() const;
+        double mean() const;
+        double variance() const;  // Sample variance, 0 with fewer than 2 samples
+        double std_dev() const;
+
+    private:
+        int64_t n = 0;
+        double m = 0.0;
+        double sum_of_squares = 0.0;  // Sum of squared differences from the mean
+    };
+
+    // How PercolationStats spreads its trials over threads
+    struct PercolationOptions {
+        int threads = 1;  // 0 for one per hardware thread
+        bool quiet = false;  // Print nothing, not even the stats
+
+        // Trial i draws from its own generator, seeded from the seed and i,
+        // so the thresholds are the same for any number of threads
+        uint64_t seed = 2020;
+
+        // Incremented after each trial if not null, so another thread can
+        // watch the progress
+        std::atomic<int64_t>* progress = nullptr;
+    };
+
     // Monte-Carlo simulation implementation based on Percolation model.
     // Construct different objects to see the resulting stats.
     class PercolationStats {
     public:
-        // Perform t trials on an n-by-n grid
+        // Perform t trials on an n-by-n grid, each seeded from the clock,
+        // printing a line after each trial
         PercolationStats(int n, int t);
 
+        // Perform t trials on an n-by-n grid with reproducible seeds, on
+        // options.threads threads. Only the stats are printed, unless quiet.
+        PercolationStats(int n, int t, const PercolationOptions& options);
+
+        // Perform trials on an n-by-n grid in batches, until the 95%
+        // confidence interval is within half_width of the mean or
+        // max_trials trials are done. The batches are the same for any
+        // number of threads, and so are the stats.
+        PercolationStats(int n, double half_width, int max_trials, const PercolationOptions& options);
+
+        int number_of_trials() const;  // Trials performed
+
         // Some stats of simulated percolation thresholds
         double mean() const;           // Sample mean
         double std_dev() const;        // Sample standard deviation
@@ -68,12 +379,129 @@ namespace UnionFind
         double confidence_hi() const;  // High endpoint of 95% confidence interval
 
     private:
+        // Grid and site list of one thread, reused from trial to trial
+        struct Workspace {
+            Percolation grid;
+            std::vector<int> blocked_sites;
+            Workspace(int n) : grid(n) {}
+        };
+
         const int N;
-        const int T;
-        std::vector<double> thresholds;  // Store simulated percolation thresholds
+        const int T;         // Trials to perform, or the most to perform
+        RunningStats stats;  // Stats of simulated percolation thresholds
         void run();
+        void run(const PercolationOptions& options);
+        void run(double half_width, const PercolationOptions& options);
+        void print_stats() const;
+
+        // Perform trials first to first + count - 1 on up to threads threads
+        void run_batch(int first, int count, int threads, const PercolationOptions& options,
+                       std::vector<std::unique_ptr<Workspace>>& workspaces);
+
+        // Return the threshold of one trial
+        double trial(std::mt19937_64& generator, Workspace& workspace) const;
     };
 
 #pragma endregion Percolation
 
+
+#pragma region Large Percolation
+
+    // Percolation for grids too large for Percolation, with 64-bit rows,
+    // columns and indices. Sites are stored in 8-by-8 tiles: the open status
+    // of a tile is one 64-bit word, and union-find nodes follow the same
+    // order, so the neighbours looked at by open() are mostly in the same
+    // word and the same few cache lines. A site costs one bit and 8 bytes of
+    // union-find state, so 10^9 sites take about 8 GB.
+    // Unlike Percolation, a top or bottom row site is connected to its
+    // virtual site only once it opens, so is_full is false for blocked sites.
+    class LargePercolation {
+    public:
+        LargePercolation(int64_t n);  // Creates an n-by-n grid
+
+        void open(int64_t row, int64_t col);
+        bool is_open(int64_t row, int64_t col) const;
+
+        // A site is full if it's connected to the virtual top site
+        bool is_full(int64_t row, int64_t col);
+
+        int64_t number_of_open_sites() const;
+        bool percolates();  // Does the system percolate?
+
+    private:
+        static const int tile_bits = 3;
+        static const int64_t tile_size = 1 << tile_bits;  // Tiles are tile_size by tile_size sites
+
+        const int64_t N;
+        const int64_t tiles_per_row;
+        const int64_t top;     // Index of the virtual top site
+        const int64_t bottom;  // Index of the virtual bottom site
+        CompactUnionFind grid;
+        std::vector<uint64_t> open_bits;  // Open status of each tile, one bit per site
+        int64_t open_sites_count = 0;
+
+        // Index of the site at zero-based row and col
+        int64_t index(int64_t row, int64_t col) const
+        {
+            return ((row >> tile_bits) * tiles_per_row + (col >> tile_bits)) << (2 * tile_bits)
+                 | (row & (tile_size - 1)) << tile_bits | (col & (tile_size - 1));
+        }
+
+        bool is_open_at(int64_t i) const
+        {
+            return (open_bits[i >> (2 * tile_bits)] >> (i & 63)) & 1;
+        }
+    };
+
+#pragma endregion Large Percolation
+
+
+#pragma region Newman-Ziff
+
+    // Observables of an n-by-n grid where each site is open with
+    // probability p, averaged over sweeps
+    struct PercolationPoint {
+        double probability;
+        double percolating;      // Chance that the top row connects to the bottom row
+        double largest_cluster;  // Share of all sites that are in the largest cluster
+    };
+
+    // Newman-Ziff percolation: a sweep shuffles the order of all sites once
+    // and opens them one at a time, keeping the size of each cluster and
+    // whether it touches the top or bottom row in its root. After each site
+    // it records whether the grid percolates and the size of the largest
+    // cluster, so one sweep gives them for every number of open sites.
+    // Observables at a probability p are those averaged over the sweeps and
+    // weighted by the binomial chance of each number of open sites.
+    // Needs 33 bytes per site, so a 4096-by-4096 grid takes about 550 MB.
+    class NewmanZiff {
+    public:
+        NewmanZiff(int n);  // Creates an n-by-n grid
+
+        // Open all sites once in random order and add the observables to
+        // the totals. Return the share of sites open when the grid first
+        // percolated, an estimate of the percolation threshold.
+        double sweep(std::mt19937_64& generator);
+
+        int64_t number_of_sweeps() const;
+
+        // Observables at probability p, within [0, 1]
+        PercolationPoint at(double p) const;
+
+        // Observables at points evenly spaced probabilities from 0 to 1
+        std::vector<PercolationPoint> curve(int points) const;
+
+    private:
+        const int N;
+        const int64_t sites;
+        CompactUnionFind grid;
+        std::vector<int64_t> order;           // Sites in the order they open
+        std::vector<uint8_t> state;           // Open, top and bottom flags of each site
+        std::vector<uint64_t> percolated;     // Sweeps that percolated with k sites open
+        std::vector<uint64_t> largest_total;  // Sum of largest cluster sizes with k sites open
+        int64_t sweeps = 0;
+    };
+
+#pragma endregion Newman-Ziff
+
 }
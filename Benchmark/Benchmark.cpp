@@ -0,0 +1,388 @@
+// Benchmark.cpp : Solves standard sets of puzzle boards with every solver
+// mode and heuristic, and writes one CSV row per run so results can be
+// compared between releases.
+//
+// Solver statistics cost time, so they are measured in two builds. Debug
+// and Release times the solvers as they ship and writes n/a for counters.
+// Stats defines PUZZLE_SOLVER_STATS and writes counters but no times,
+// unless --timings gives it the CSV of a Release run of the same boards,
+// whose times it then uses for nodes per second. Its peak_node_memory_bytes
+// column is the peak the solver reports for its nodes and open set, or for
+// external search the buffers counted against its memory limit, not the
+// peak resident memory of the process.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <stdint.h>
+
+#include "AStar.h"
+#include "AnytimeAStar.h"
+#include "Instances.h"
+
+using namespace std;
+using namespace PuzzleBoard;
+using namespace Benchmark;
+
+
+namespace
+{
+    struct Options {
+        string suite = "eight";
+        int count = -1;  // Default depends on the suite
+        int dimension = 4;
+        int walk = 0;
+        uint64_t seed = 2020;
+        vector<string> modes = { "a_star", "bidirectional", "parallel", "external", "anytime" };
+        vector<string> heuristics = { "hamming", "manhattan", "linear_conflict", "walking_distance" };
+        int threads = 0;
+        size_t memory_limit = size_t(256) << 20;
+        string timings;
+        string output;
+        bool help = false;
+    };
+
+#ifdef PUZZLE_SOLVER_STATS
+    const bool counted_build = true;
+#else
+    const bool counted_build = false;
+#endif
+
+    const char* usage =
+        "Usage: Benchmark [options]\n"
+        "  --suite eight|korf|random  Instance set, default eight\n"
+        "  --count N                  Number of boards, default 100 (korf: all 100, random: 20)\n"
+        "  --dimension N              Dimension of random boards, default 4\n"
+        "  --walk K                   Make random boards with K random moves from the goal\n"
+        "  --seed S                   Seed of random boards, default 2020\n"
+        "  --modes a,b,...            Any of a_star, bidirectional, parallel, external, anytime\n"
+        "  --heuristics a,b,...       Any of hamming, manhattan, linear_conflict, walking_distance\n"
+        "  --threads T                Threads of parallel search, default one per hardware thread\n"
+        "  --memory-limit MiB         RAM of external search, default 256\n"
+        "  --timings FILE             CSV of a Release run to take times from, Stats build only\n"
+        "  --output FILE              Write CSV to FILE instead of standard output\n"
+        "  --help                     Show this message\n"
+        "Korf's boards take far too long with hamming or manhattan alone, so try\n"
+        "  Benchmark --suite korf --count 10 --modes a_star --heuristics walking_distance\n";
+
+    vector<string> split(const string& list)
+    {
+        vector<string> items;
+        stringstream stream(list);
+        string item;
+        while (getline(stream, item, ',')) {
+            items.push_back(item);
+        }
+
+        return items;
+    }
+
+    Options parse(int argc, char* argv[])
+    {
+        Options options;
+
+        for (int i = 1; i < argc; ++i) {
+            string name = argv[i];
+            if (name == "--help") {
+                options.help = true;
+                return options;
+            }
+            if (i + 1 >= argc) {
+                throw invalid_argument("Benchmark: " + name + " needs a value!");
+            }
+            string value = argv[++i];
+
+            if (name == "--suite") {
+                options.suite = value;
+            }
+            else if (name == "--count") {
+                options.count = stoi(value);
+            }
+            else if (name == "--dimension") {
+                options.dimension = stoi(value);
+            }
+            else if (name == "--walk") {
+                options.walk = stoi(value);
+            }
+            else if (name == "--seed") {
+                options.seed = stoull(value);
+            }
+            else if (name == "--modes") {
+                options.modes = split(value);
+            }
+            else if (name == "--heuristics") {
+                options.heuristics = split(value);
+            }
+            else if (name == "--threads") {
+                options.threads = stoi(value);
+            }
+            else if (name == "--memory-limit") {
+                options.memory_limit = static_cast<size_t>(stoull(value)) << 20;
+            }
+            else if (name == "--timings") {
+                options.timings = value;
+            }
+            else if (name == "--output") {
+                options.output = value;
+            }
+            else {
+                throw invalid_argument("Benchmark: unknown option " + name + "!");
+            }
+        }
+
+        return options;
+    }
+
+    Heuristic heuristic_of(const string& name)
+    {
+        static const map<string, Heuristic> heuristics = {
+            { "hamming", Heuristic::hamming },
+            { "manhattan", Heuristic::manhattan },
+            { "linear_conflict", Heuristic::linear_conflict },
+            { "walking_distance", Heuristic::walking_distance },
+        };
+        auto found = heuristics.find(name);
+        if (found == heuristics.end()) {
+            throw invalid_argument("Benchmark: unknown heuristic " + name + "!");
+        }
+
+        return found->second;
+    }
+
+    // Key of a run in a CSV of timings
+    string run_key(const string& suite, const string& instance, const string& mode,
+                   const string& heuristic, const string& threads)
+    {
+        return suite + ',' + instance + ',' + mode + ',' + heuristic + ',' + threads;
+    }
+
+    // Seconds of each run in a CSV written by this program
+    map<string, double> read_timings(const string& file_name)
+    {
+        ifstream in(file_name);
+        string line;
+        if (!in || !getline(in, line)) {
+            throw invalid_argument("Benchmark: cannot read " + file_name + "!");
+        }
+
+        vector<string> header = split(line);
+        map<string, size_t> column;
+        for (size_t i = 0; i < header.size(); ++i) {
+            column[header[i]] = i;
+        }
+        for (const char* name : { "suite", "instance", "mode", "heuristic", "threads", "seconds" }) {
+            if (column.find(name) == column.end()) {
+                throw invalid_argument("Benchmark: " + file_name + " has no " + name + " column!");
+            }
+        }
+
+        map<string, double> timings;
+        while (getline(in, line)) {
+            vector<string> fields = split(line);
+            if (fields.size() != header.size() || fields[column["seconds"]] == "n/a") {
+                continue;
+            }
+            string key = run_key(fields[column["suite"]], fields[column["instance"]], fields[column["mode"]],
+                                 fields[column["heuristic"]], fields[column["threads"]]);
+            timings[key] = stod(fields[column["seconds"]]);
+        }
+
+        return timings;
+    }
+
+    // Outcome of solving one board with one mode and heuristic
+    struct Run {
+        int moves = -1;
+        double seconds = 0.0;
+        bool counted = false;  // Are the counters below filled?
+        uint64_t nodes_expanded = 0;
+        uint64_t nodes_generated = 0;
+        size_t peak_node_memory = 0;  // Bytes of nodes and open set reported by the solver
+    };
+
+    void count(Run& run, const SolverStats& stats)
+    {
+        run.counted = counted_build;
+        run.nodes_expanded = stats.nodes_expanded;
+        run.nodes_generated = stats.nodes_generated;
+        run.peak_node_memory = stats.peak_node_memory;
+    }
+
+    // value, or n/a if it is not known
+    template <class T>
+    string field(bool known, T value)
+    {
+        if (!known) {
+            return "n/a";
+        }
+        ostringstream text;
+        text << value;
+        return text.str();
+    }
+
+    Run solve(const Board& board, const string& mode, Heuristic heuristic, const Options& options)
+    {
+        Run run;
+        auto start = chrono::steady_clock::now();
+
+        if (mode == "anytime") {
+            AnytimeOptions anytime_options;
+            anytime_options.heuristic = heuristic;
+            AnytimeSolver solver(board, anytime_options);
+            solver.search(0);
+            run.moves = solver.min_moves();
+            count(run, solver.statistics());
+        }
+        else {
+            SolverOptions solver_options;
+            solver_options.heuristic = heuristic;
+            solver_options.threads = options.threads;
+            solver_options.memory_limit = options.memory_limit;
+            if (mode == "a_star") {
+                solver_options.mode = SearchMode::a_star;
+            }
+            else if (mode == "bidirectional") {
+                solver_options.mode = SearchMode::bidirectional;
+            }
+            else if (mode == "parallel") {
+                solver_options.mode = SearchMode::parallel;
+            }
+            else if (mode == "external") {
+                solver_options.mode = SearchMode::external;
+            }
+            else {
+                throw invalid_argument("Benchmark: unknown mode " + mode + "!");
+            }
+
+            Solver solver(board, solver_options);
+            run.moves = solver.min_moves();
+            count(run, solver.statistics());
+        }
+
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        run.seconds = elapsed.count();
+        return run;
+    }
+}
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    vector<Instance> instances;
+    map<string, double> timings;
+    try {
+        options = parse(argc, argv);
+        if (options.help) {
+            cout << usage;
+            return 0;
+        }
+        if (options.suite == "eight") {
+            instances = random_8_puzzles(options.count < 0 ? 100 : options.count, options.seed);
+        }
+        else if (options.suite == "korf") {
+            instances = korf_100();
+            if (options.count >= 0 && options.count < static_cast<int>(instances.size())) {
+                instances.erase(instances.begin() + options.count, instances.end());
+            }
+        }
+        else if (options.suite == "random") {
+            instances = random_boards(options.dimension, options.count < 0 ? 20 : options.count,
+                                      options.seed, options.walk);
+        }
+        else {
+            throw invalid_argument("Benchmark: unknown suite " + options.suite + "!");
+        }
+        for (const string& name : options.heuristics) {
+            heuristic_of(name);
+        }
+        if (!options.timings.empty() && !counted_build) {
+            throw invalid_argument("Benchmark: --timings is for the Stats build, which has no times of its own!");
+        }
+        if (!options.timings.empty()) {
+            timings = read_timings(options.timings);
+        }
+    }
+    catch (const exception& e) {
+        cerr << e.what() << '\n' << usage;
+        return 2;
+    }
+
+    ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output);
+        if (!file) {
+            cerr << "Benchmark: cannot write " << options.output << "!\n";
+            return 2;
+        }
+    }
+    ostream& out = options.output.empty() ? cout : file;
+
+    int threads = options.threads > 0 ? options.threads : static_cast<int>(thread::hardware_concurrency());
+    out << "suite,instance,dimension,mode,heuristic,threads,moves,optimal,check,"
+           "seconds,nodes_expanded,nodes_generated,nodes_per_second,peak_node_memory_bytes\n";
+
+    int failures = 0;
+    for (const Instance& instance : instances) {
+        // Without a published minimum, the first run is the reference
+        int reference = instance.optimal;
+        int n = instance.board.dimension();
+
+        for (const string& heuristic_name : options.heuristics) {
+            Heuristic heuristic = heuristic_of(heuristic_name);
+            if (heuristic == Heuristic::walking_distance && n > WalkingDistance::max_dimension) {
+                continue;
+            }
+
+            for (const string& mode : options.modes) {
+                Run run;
+                string check;
+                try {
+                    run = solve(instance.board, mode, heuristic, options);
+                    if (reference < 0) {
+                        reference = run.moves;
+                        check = "reference";
+                    }
+                    else {
+                        check = run.moves == reference ? "ok" : "wrong";
+                    }
+                }
+                catch (const exception& e) {
+                    cerr << instance.name << ' ' << mode << ' ' << heuristic_name << ": " << e.what() << '\n';
+                    check = "error";
+                }
+                failures += check == "wrong" || check == "error";
+
+                // Times of a Stats build include its instrumentation, so
+                // they come from a Release run if there is one
+                string run_threads = to_string(mode == "parallel" ? threads : 1);
+                bool timed = !counted_build;
+                if (counted_build) {
+                    auto timing = timings.find(run_key(options.suite, instance.name, mode, heuristic_name, run_threads));
+                    timed = timing != timings.end();
+                    run.seconds = timed ? timing->second : 0.0;
+                }
+                bool per_second = timed && run.counted && run.seconds > 0;
+
+                out << options.suite << ',' << instance.name << ',' << n << ',' << mode << ','
+                    << heuristic_name << ',' << run_threads << ','
+                    << run.moves << ',' << instance.optimal << ',' << check << ','
+                    << field(timed, run.seconds) << ','
+                    << field(run.counted, run.nodes_expanded) << ','
+                    << field(run.counted, run.nodes_generated) << ','
+                    << field(per_second, per_second ? run.nodes_expanded / run.seconds : 0.0) << ','
+                    << field(run.counted, run.peak_node_memory) << '\n';
+                out.flush();
+            }
+        }
+    }
+
+    cerr << instances.size() << " boards, " << failures << " failed checks\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "AStar.h"
+
+namespace Benchmark
+{
+
+#pragma region Instances
+
+    // A board to solve, with its minimum number of moves if it is known
+    struct Instance {
+        std::string name;
+        PuzzleBoard::Board board;
+        int optimal;  // -1 if not known
+    };
+
+    // Korf's 100 random 15-puzzles (1985), with their published minimum
+    // numbers of moves. Korf's goal has the empty tile in the top left
+    // corner, so the boards are turned half a turn and relabelled to this
+    // library's goal, which keeps every minimum the same.
+    std::vector<Instance> korf_100();
+
+    // Random solvable 8-puzzles, with minimum numbers of moves from a
+    // breadth-first search of all boards
+    std::vector<Instance> random_8_puzzles(int count, uint64_t seed);
+
+    // Random solvable boards of dimension n. With walk 0 the tiles are
+    // shuffled, and two of them swapped if that leaves the board unsolvable.
+    // Otherwise the empty tile takes walk random moves from the goal,
+    // never undoing the move before, which keeps large boards in reach.
+    std::vector<Instance> random_boards(int n, int count, uint64_t seed, int walk = 0);
+
+#pragma endregion Instances
+
+}
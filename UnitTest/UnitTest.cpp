@@ -1,12 +1,56 @@
 #include "pch.h"
 #include "CppUnitTest.h"
+#include <cstdlib>
+#include <thread>
 #include "../Algorithms/AStar.h"
 #include "../Algorithms/Astar.cpp"
+#include "../Algorithms/ParallelAStar.cpp"
+#include "../Algorithms/ExternalAStar.cpp"
+#include "../Algorithms/AnytimeAStar.cpp"
+#include "../Algorithms/PuzzleBatch.cpp"
+#include "../Algorithms/UnionFind.cpp"
+#include "../Algorithms/EdgeList.cpp"
+#include "../Algorithms/GridLabeling.cpp"
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
 
 namespace UnitTest
 {
+// Grid map with walls, where a step to a side square costs 1
+struct GridDomain {
+  typedef int State;  // Index of a square
+  typedef int Action;
+  static const bool stores_states = true;
+  static const bool detects_duplicates = true;
+  typedef int Key;
+  typedef std::hash<int> Hash;
+
+  std::vector<std::string> rows;
+  int goal;
+
+  int width() const { return static_cast<int>(rows[0].size()); }
+  Key key(int square) const { return square; }
+  int estimate(int square) const {
+    return std::abs(square / width() - goal / width()) + std::abs(square % width() - goal % width());
+  }
+  bool is_goal(int square, int) const { return square == goal; }
+  void apply(int& square, int action) const { square += action; }
+
+  template <class Visitor>
+  void successors(int& square, int, const int*, Visitor& visit) const {
+    const int steps[] = { -width(), width(), -1, 1 };
+    for (int step : steps) {
+      int next = square + step;
+      if (next < 0 || next >= width() * static_cast<int>(rows.size())
+          || (std::abs(step) == 1 && next / width() != square / width())
+          || rows[next / width()][next % width()] == '#') {
+        continue;
+      }
+      visit(next, step, 1, estimate(next));
+    }
+  }
+};
+
 TEST_CLASS(UnitTest) {
 public:
   TEST_METHOD(TestMethod1) {
@@ -15,6 +59,763 @@ public:
     PuzzleBoard::Board board(tiles);
     Assert::AreEqual(board.is_goal(), false);
   }
+
+  TEST_METHOD(TestHeuristicDelta) {
+    int arr[] = { 5, 1, 3, 4, 2, 0, 7, 8, 9, 6, 10, 12, 13, 14, 11, 15 };
+    std::vector<int> tiles(arr, arr + sizeof(arr) / sizeof(int));
+    PuzzleBoard::Board board(tiles);
+    PuzzleBoard::Heuristic heuristics[] = {
+      PuzzleBoard::Heuristic::hamming, PuzzleBoard::Heuristic::manhattan,
+      PuzzleBoard::Heuristic::linear_conflict, PuzzleBoard::Heuristic::walking_distance
+    };
+    Assert::IsTrue(board.linear_conflict() >= board.manhattan());
+    for (PuzzleBoard::Board neighbour : board.neighbours()) {
+      for (PuzzleBoard::Heuristic h : heuristics) {
+        Assert::AreEqual(board.heuristic(h) + board.heuristic_delta(h, neighbour.blank_position()),
+                         neighbour.heuristic(h));
+      }
+    }
+  }
+
+  TEST_METHOD(TestSolvability) {
+    int arr[] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 11, 12, 13, 14, 15, 10 };
+    std::vector<int> tiles(arr, arr + sizeof(arr) / sizeof(int));
+    PuzzleBoard::Board board(tiles);
+    Assert::IsTrue(board.is_solvable());
+    Assert::IsFalse(board.twin().is_solvable());
+
+    PuzzleBoard::Solver solver(board.twin());
+    Assert::IsFalse(solver.is_solvable());
+    Assert::AreEqual(solver.min_moves(), -1);
+  }
+
+  TEST_METHOD(TestBidirectional) {
+    int arr[] = { 5, 1, 3, 4, 2, 0, 7, 8, 9, 6, 10, 12, 13, 14, 11, 15 };
+    std::vector<int> tiles(arr, arr + sizeof(arr) / sizeof(int));
+    PuzzleBoard::Board board(tiles);
+    PuzzleBoard::SolverOptions options;
+    options.heuristic = PuzzleBoard::Heuristic::linear_conflict;
+    PuzzleBoard::Solver forward(board, options);
+    options.mode = PuzzleBoard::SearchMode::bidirectional;
+    PuzzleBoard::Solver bidirectional(board, options);
+
+    Assert::AreEqual(bidirectional.min_moves(), forward.min_moves());
+    auto solution = bidirectional.solution();
+    Assert::IsTrue(solution.front().equals(board));
+    Assert::IsTrue(solution.back().is_goal());
+  }
+
+  TEST_METHOD(TestGridEngine) {
+    GridDomain grid;
+    grid.rows = { "....#...",
+                  ".##.#.#.",
+                  ".#..#.#.",
+                  ".#.##.#.",
+                  "...#..#.",
+                  ".#...##." };
+    grid.goal = 5 * 8 + 7;
+    HeuristicSearch::AStarEngine<GridDomain> engine;
+    std::vector<int> path;
+
+    int cost = engine.search(grid, 0, path);
+    Assert::AreEqual(cost, 22);
+    Assert::AreEqual(cost, static_cast<int>(path.size()));
+    int square = 0;
+    for (int step : path) {
+      square += step;
+      Assert::IsTrue(grid.rows[square / 8][square % 8] == '.');
+    }
+    Assert::AreEqual(square, grid.goal);
+
+    // Statistics are only kept by an engine built with a counter
+    HeuristicSearch::EngineStats stats;
+    engine.search(grid, 0, path, stats);
+    Assert::AreEqual(stats.nodes_generated, static_cast<uint64_t>(0));
+    HeuristicSearch::AStarEngine<GridDomain, Sorting::MinPriorityQueue,
+                                 HeuristicSearch::NoTimer, HeuristicSearch::NodeCounter> counted;
+    Assert::AreEqual(counted.search(grid, 0, path, stats), cost);
+    Assert::IsTrue(stats.nodes_expanded > 0 && stats.nodes_expanded <= stats.nodes_generated);
+    Assert::IsTrue(stats.peak_open_set > 0 && stats.peak_node_memory > 0);
+
+    grid.rows[4][7] = '#';
+    grid.rows[5][6] = '#';
+    Assert::AreEqual(engine.search(grid, 0, path), -1);
+  }
+
+  TEST_METHOD(TestMoveSequence) {
+    int arr[] = { 5, 1, 3, 4, 2, 0, 7, 8, 9, 6, 10, 12, 13, 14, 11, 15 };
+    std::vector<int> tiles(arr, arr + sizeof(arr) / sizeof(int));
+    PuzzleBoard::Board board(tiles);
+    PuzzleBoard::Solver solver(board);
+
+    PuzzleBoard::MoveSequence moves = solver.solution_moves();
+    Assert::AreEqual(static_cast<int>(moves.size()), solver.min_moves());
+    Assert::IsTrue(PuzzleBoard::MoveSequence::from_string(moves.to_string()).to_string() == moves.to_string());
+
+    auto solution = solver.solution();
+    size_t i = 0;
+    for (const PuzzleBoard::Board& step : solver.solution_path()) {
+      Assert::IsTrue(step.equals(solution[i++]));
+    }
+    Assert::AreEqual(i, solution.size());
+
+    Assert::ExpectException<std::invalid_argument>([] {
+      PuzzleBoard::MoveSequence::from_string("UDX");
+    });
+  }
+
+  TEST_METHOD(TestExternal) {
+    int arr[] = { 5, 1, 3, 4, 2, 0, 7, 8, 9, 6, 10, 12, 13, 14, 11, 15 };
+    std::vector<int> tiles(arr, arr + sizeof(arr) / sizeof(int));
+    PuzzleBoard::Board board(tiles);
+    PuzzleBoard::SolverOptions options;
+    PuzzleBoard::Solver solver(board, options);
+    options.mode = PuzzleBoard::SearchMode::external;
+    options.memory_limit = 1 << 20;
+    PuzzleBoard::Solver external(board, options);
+
+    Assert::AreEqual(external.min_moves(), solver.min_moves());
+    auto solution = external.solution();
+    Assert::IsTrue(solution.front().equals(board));
+    Assert::IsTrue(solution.back().is_goal());
+    Assert::IsTrue(external.statistics().peak_node_memory > 0);
+    Assert::IsTrue(external.statistics().peak_node_memory <= options.memory_limit);
+
+    options.memory_limit = 1 << 10;
+    Assert::ExpectException<std::invalid_argument>([&] {
+      PuzzleBoard::Solver rejected(board, options);
+    });
+  }
+
+  TEST_METHOD(TestAnytime) {
+    int arr[] = { 5, 1, 3, 4, 2, 0, 7, 8, 9, 6, 10, 12, 13, 14, 11, 15 };
+    std::vector<int> tiles(arr, arr + sizeof(arr) / sizeof(int));
+    PuzzleBoard::Board board(tiles);
+    PuzzleBoard::Solver solver(board);
+    PuzzleBoard::AnytimeSolver anytime(board);
+
+    Assert::IsFalse(anytime.search(0, 1));
+    while (!anytime.search(0, 10)) {
+      if (anytime.has_solution()) {
+        Assert::IsTrue(anytime.min_moves() <= anytime.suboptimality_bound() * solver.min_moves());
+      }
+    }
+    Assert::AreEqual(anytime.min_moves(), solver.min_moves());
+    Assert::IsTrue(anytime.suboptimality_bound() == 1.0);
+    const PuzzleBoard::SolverStats& stats = anytime.statistics();
+    Assert::IsTrue(stats.nodes_expanded > 0 && stats.nodes_expanded <= stats.nodes_generated);
+    Assert::IsTrue(stats.peak_open_set > 0 && stats.peak_node_memory > 0);
+    auto solution = anytime.solution();
+    Assert::IsTrue(solution.front().equals(board));
+    Assert::IsTrue(solution.back().is_goal());
+  }
+
+  TEST_METHOD(TestCompactUnionFind) {
+    UnionFind::CompactUnionFind uf(10);
+    uf.connect(1, 2);
+    uf.connect(3, 4);
+    uf.connect(2, 4);
+
+    Assert::IsTrue(uf.is_connected(1, 3));
+    Assert::IsFalse(uf.is_connected(0, 1));
+    Assert::AreEqual(uf.component_size(4), static_cast<int64_t>(4));
+    Assert::AreEqual(uf.find_unchecked(1), uf.find(3));
+    Assert::ExpectException<std::invalid_argument>([&] { uf.connect(0, 10); });
+
+    UnionFind::Percolation percolation(3);
+    percolation.open(1, 2);
+    percolation.open(2, 2);
+    Assert::IsFalse(percolation.percolates());
+    percolation.open(3, 2);
+    Assert::IsTrue(percolation.percolates());
+    Assert::IsTrue(percolation.is_full(3, 2));
+  }
+
+  TEST_METHOD(TestConcurrentUnionFind) {
+    const int n = 100000;
+    UnionFind::ConcurrentUnionFind uf(n);
+
+    // Each thread links every fourth pair of neighbours, so together they
+    // join all even nodes and all odd nodes into two chains. Asserts throw,
+    // so each thread only counts the pairs it finds apart after linking them.
+    std::vector<std::thread> threads;
+    std::vector<int> apart(4, 0);
+    for (int t = 0; t < 4; ++t) {
+      threads.emplace_back([&uf, &apart, t] {
+        for (int i = 2 * t; i + 2 < n; i += 8) {
+          uf.connect(i, i + 2);
+          uf.connect(i + 1, i + 3);
+          apart[t] += !uf.is_connected(i, i + 2);
+        }
+      });
+    }
+    for (std::thread& thread : threads) {
+      thread.join();
+    }
+
+    for (int count : apart) {
+      Assert::AreEqual(count, 0);
+    }
+
+    Assert::AreEqual(uf.count(), static_cast<int64_t>(2));
+    Assert::IsTrue(uf.is_connected(0, n - 2));
+    Assert::IsTrue(uf.is_connected(1, n - 1));
+    Assert::IsFalse(uf.is_connected(0, 1));
+    Assert::ExpectException<std::invalid_argument>([&] { uf.find(-1); });
+  }
+
+  TEST_METHOD(TestParallelPercolationStats) {
+    std::atomic<int64_t> progress(0);
+    UnionFind::PercolationOptions options;
+    options.seed = 42;
+    options.progress = &progress;
+    UnionFind::PercolationStats one(20, 30, options);
+    Assert::AreEqual(progress.load(), static_cast<int64_t>(30));
+
+    options.threads = 3;
+    UnionFind::PercolationStats three(20, 30, options);
+    Assert::AreEqual(three.mean(), one.mean());
+    Assert::AreEqual(three.std_dev(), one.std_dev());
+
+    options.seed = 43;
+    UnionFind::PercolationStats other(20, 30, options);
+    Assert::AreNotEqual(other.mean(), one.mean());
+  }
+
+  TEST_METHOD(TestNewmanZiff) {
+    std::mt19937_64 generator(7);
+
+    // A single site percolates exactly when it is open
+    UnionFind::NewmanZiff single(1);
+    Assert::AreEqual(single.sweep(generator), 1.0);
+    Assert::IsTrue(std::abs(single.at(0.3).percolating - 0.3) < 1e-12);
+    Assert::IsTrue(std::abs(single.at(0.3).largest_cluster - 0.3) < 1e-12);
+
+    UnionFind::NewmanZiff sweeper(64);
+    double sum = 0.0;
+    for (int i = 0; i < 20; ++i) {
+      sum += sweeper.sweep(generator);
+    }
+    Assert::IsTrue(std::abs(sum / 20 - 0.593) < 0.05);
+    auto curve = sweeper.curve(21);
+    Assert::AreEqual(curve.front().percolating, 0.0);
+    Assert::AreEqual(curve.back().percolating, 1.0);
+    Assert::AreEqual(curve.back().largest_cluster, 1.0);
+    for (size_t i = 1; i < curve.size(); ++i) {
+      Assert::IsTrue(curve[i].percolating >= curve[i - 1].percolating - 1e-12);
+    }
+    Assert::IsTrue(sweeper.at(0.4).percolating < 0.05 && sweeper.at(0.8).percolating > 0.95);
+  }
+
+  TEST_METHOD(TestLargePercolation) {
+    // A size that does not fill its last tiles, checked against Percolation
+    const int n = 13;
+    UnionFind::Percolation small(n);
+    UnionFind::LargePercolation large(n);
+    std::mt19937_64 generator(3);
+    std::uniform_int_distribution<int> distribution(1, n);
+    while (!small.percolates()) {
+      int row = distribution(generator);
+      int col = distribution(generator);
+      small.open(row, col);
+      large.open(row, col);
+      Assert::AreEqual(large.percolates(), small.percolates());
+      Assert::AreEqual(large.number_of_open_sites(), static_cast<int64_t>(small.number_of_open_sites()));
+    }
+    for (int row = 1; row <= n; ++row) {
+      for (int col = 1; col <= n; ++col) {
+        Assert::AreEqual(large.is_open(row, col), small.is_open(row, col));
+        Assert::AreEqual(large.is_full(row, col), small.is_open(row, col) && small.is_full(row, col));
+      }
+    }
+    Assert::ExpectException<std::invalid_argument>([&] { large.open(n + 1, 1); });
+  }
+
+  TEST_METHOD(TestPercolationReset) {
+    UnionFind::WeightedQuickUnion uf(4);
+    uf.connect(0, 1);
+    uf.reset();
+    Assert::IsFalse(uf.is_connected(0, 1));
+
+    UnionFind::Percolation percolation(2);
+    percolation.open(1, 1);
+    percolation.open(2, 1);
+    Assert::IsTrue(percolation.percolates());
+    percolation.reset();
+    Assert::IsFalse(percolation.percolates());
+    Assert::IsFalse(percolation.is_open(1, 1));
+    Assert::AreEqual(percolation.number_of_open_sites(), 0);
+
+    UnionFind::RunningStats stats;
+    double samples[] = { 2.0, 4.0, 4.0, 4.0, 5.0, 5.0, 7.0, 9.0 };
+    for (double x : samples) {
+      stats.add(x);
+    }
+    Assert::AreEqual(stats.count(), static_cast<int64_t>(8));
+    Assert::IsTrue(std::abs(stats.mean() - 5.0) < 1e-12);
+    Assert::IsTrue(std::abs(stats.variance() - 32.0 / 7) < 1e-12);
+
+    UnionFind::PercolationOptions options;
+    options.quiet = true;
+    UnionFind::PercolationStats many(3, 10000, options);
+    Assert::IsTrue(many.confidence_lo() < many.mean() && many.mean() < many.confidence_hi());
+  }
+
+  TEST_METHOD(TestAdaptivePercolationStats) {
+    UnionFind::PercolationOptions options;
+    options.quiet = true;
+    UnionFind::PercolationStats one(10, 0.01, 100000, options);
+    Assert::IsTrue((one.confidence_hi() - one.confidence_lo()) / 2 <= 0.01);
+    Assert::IsTrue(one.number_of_trials() >= 32 && one.number_of_trials() < 100000);
+
+    options.threads = 3;
+    UnionFind::PercolationStats three(10, 0.01, 100000, options);
+    Assert::AreEqual(three.number_of_trials(), one.number_of_trials());
+    Assert::AreEqual(three.mean(), one.mean());
+
+    UnionFind::PercolationStats capped(10, 1e-6, 50, options);
+    Assert::AreEqual(capped.number_of_trials(), 50);
+  }
+
+  TEST_METHOD(TestFreeze) {
+    UnionFind::WeightedQuickUnion uf(6);
+    uf.connect(5, 3);
+    uf.connect(1, 3);
+    uf.connect(2, 4);
+    UnionFind::FrozenConnectivity frozen = uf.freeze();
+
+    // Labels follow the first node of each component
+    int64_t expected[] = { 0, 1, 2, 1, 2, 1 };
+    Assert::IsTrue(frozen.labels() == std::vector<int64_t>(expected, expected + 6));
+    Assert::AreEqual(frozen.number_of_components(), static_cast<int64_t>(3));
+    Assert::IsTrue(frozen.same_component(1, 5));
+    Assert::IsFalse(frozen.same_component(0, 5));
+    Assert::AreEqual(frozen.component_size(3), static_cast<int64_t>(3));
+    Assert::ExpectException<std::invalid_argument>([&] { frozen.component(6); });
+
+    UnionFind::CompactUnionFind compact(6);
+    compact.connect(5, 3);
+    compact.connect(1, 3);
+    compact.connect(2, 4);
+    Assert::IsTrue(compact.freeze().labels() == frozen.labels());
+  }
+
+  TEST_METHOD(TestBatchConnectivity) {
+    std::mt19937_64 generator(5);
+    std::uniform_int_distribution<int64_t> node(0, 999);
+    std::vector<UnionFind::NodePair> edges(600), queries(300);
+    for (auto& edge : edges) {
+      edge = UnionFind::NodePair{ node(generator), node(generator) };
+    }
+    for (auto& query : queries) {
+      query = UnionFind::NodePair{ node(generator), node(generator) };
+    }
+
+    UnionFind::CompactUnionFind one_by_one(1000), batched(1000), sorted(1000);
+    for (const auto& edge : edges) {
+      one_by_one.connect(edge.a, edge.b);
+    }
+    batched.connect_batch(edges);
+    sorted.connect_batch(edges, true);
+
+    UnionFind::Bitmap plain = batched.is_connected_batch(queries);
+    UnionFind::Bitmap local = sorted.is_connected_batch(queries, true);
+    Assert::AreEqual(plain.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); ++i) {
+      bool expected = one_by_one.is_connected(queries[i].a, queries[i].b);
+      Assert::AreEqual(plain[i], expected);
+      Assert::AreEqual(local[i], expected);
+    }
+
+    queries.push_back(UnionFind::NodePair{ 0, 1000 });
+    Assert::ExpectException<std::invalid_argument>([&] { batched.is_connected_batch(queries); });
+  }
+
+  TEST_METHOD(TestRollbackUnionFind) {
+    UnionFind::RollbackUnionFind uf(5);
+    uf.connect(0, 1);
+    int64_t mark = uf.snapshot();
+    Assert::IsTrue(uf.connect(1, 2));
+    Assert::IsFalse(uf.connect(0, 2));
+    uf.connect(3, 4);
+    Assert::AreEqual(uf.count(), static_cast<int64_t>(2));
+    uf.rollback(mark);
+    Assert::IsTrue(uf.is_connected(0, 1));
+    Assert::IsFalse(uf.is_connected(1, 2));
+    Assert::IsFalse(uf.is_connected(3, 4));
+    Assert::AreEqual(uf.count(), static_cast<int64_t>(4));
+  }
+
+  TEST_METHOD(TestDynamicConnectivity) {
+    // Random timeline, checked against a fresh union-find at every query
+    const int n = 12;
+    std::mt19937_64 generator(11);
+    std::uniform_int_distribution<int> node(0, n - 1);
+    UnionFind::DynamicConnectivity graph(n);
+    std::vector<std::pair<int, int>> edges;
+    std::vector<bool> expected;
+    for (int step = 0; step < 600; ++step) {
+      int kind = static_cast<int>(generator() % 3);
+      if (kind == 0 || edges.empty()) {
+        int a = node(generator), b = node(generator);
+        graph.add(a, b);
+        edges.emplace_back(a, b);
+      }
+      else if (kind == 1) {
+        size_t i = generator() % edges.size();
+        graph.remove(edges[i].second, edges[i].first);
+        edges.erase(edges.begin() + i);
+      }
+      else {
+        int a = node(generator), b = node(generator);
+        graph.query(a, b);
+        UnionFind::WeightedQuickUnion uf(n);
+        for (const auto& edge : edges) {
+          uf.connect(edge.first, edge.second);
+        }
+        expected.push_back(uf.is_connected(a, b));
+      }
+    }
+
+    UnionFind::Bitmap answers = graph.solve();
+    Assert::AreEqual(answers.size(), expected.size());
+    for (size_t i = 0; i < expected.size(); ++i) {
+      Assert::AreEqual(answers[i], static_cast<bool>(expected[i]));
+    }
+    UnionFind::DynamicConnectivity empty(2);
+    Assert::ExpectException<std::invalid_argument>([&] { empty.remove(0, 1); });
+  }
+
+  TEST_METHOD(TestEdgeListComponents) {
+    const int n = 3000;
+    std::mt19937_64 generator(13);
+    std::uniform_int_distribution<int> node(0, n - 1);
+    std::vector<UnionFind::NodePair> edges(2000);
+    for (auto& edge : edges) {
+      edge = UnionFind::NodePair{ node(generator), node(generator) };
+    }
+    UnionFind::CompactUnionFind expected(n + 1);
+    for (const auto& edge : edges) {
+      expected.connect(edge.a, edge.b);
+    }
+
+    {
+      std::ofstream text("edges.txt");
+      text << "# test graph\n";
+      for (const auto& edge : edges) {
+        text << edge.a << '\t' << edge.b << " 1.5\n";
+      }
+      std::ofstream binary("edges.bin", std::ios::binary);
+      for (const auto& edge : edges) {
+        uint32_t ids[] = { static_cast<uint32_t>(edge.a), static_cast<uint32_t>(edge.b) };
+        binary.write(reinterpret_cast<const char*>(ids), sizeof(ids));
+      }
+    }
+
+    // Small buffers make the reader cut lines and records across buffers
+    UnionFind::EdgeListOptions options;
+    options.threads = 3;
+    options.buffer_size = 4096;
+    UnionFind::EdgeListComponents from_text(options);
+    from_text.read("edges.txt");
+    options.format = UnionFind::EdgeFormat::binary32;
+    options.nodes = n + 1;
+    UnionFind::EdgeListComponents from_binary(options);
+    from_binary.read("edges.bin");
+
+    Assert::AreEqual(from_text.number_of_edges(), static_cast<int64_t>(edges.size()));
+    Assert::AreEqual(from_binary.number_of_edges(), static_cast<int64_t>(edges.size()));
+    std::vector<int64_t> labels = expected.freeze().labels();
+    std::vector<int64_t> text_labels = from_text.components().labels();
+    // Nodes past the largest id in the file are left out, and they come last
+    Assert::IsTrue(std::equal(text_labels.begin(), text_labels.end(), labels.begin()));
+    Assert::IsTrue(from_binary.components().labels() == labels);
+
+    from_binary.write_histogram("histogram.txt");
+    std::ifstream histogram("histogram.txt");
+    int64_t size, count, total = 0;
+    while (histogram >> size >> count) {
+      total += size * count;
+    }
+    Assert::AreEqual(total, static_cast<int64_t>(n + 1));
+
+    std::remove("edges.txt");
+    std::remove("edges.bin");
+    std::remove("histogram.txt");
+  }
+
+  TEST_METHOD(TestGridLabeling) {
+    // Rows wider than a word, checked against connecting sites one by one
+    const int rows = 37, cols = 150;
+    std::mt19937_64 generator(17);
+    std::bernoulli_distribution open(0.6);
+    UnionFind::OccupancyGrid grid(rows, cols);
+    UnionFind::CompactUnionFind sites(rows * cols);
+    for (int r = 0; r < rows; ++r) {
+      for (int c = 0; c < cols; ++c) {
+        grid.set(r, c, open(generator));
+      }
+    }
+    for (int r = 0; r < rows; ++r) {
+      for (int c = 0; c < cols; ++c) {
+        if (grid.is_open(r, c) && c + 1 < cols && grid.is_open(r, c + 1)) {
+          sites.connect(r * cols + c, r * cols + c + 1);
+        }
+        if (grid.is_open(r, c) && r + 1 < rows && grid.is_open(r + 1, c)) {
+          sites.connect(r * cols + c, (r + 1) * cols + c);
+        }
+      }
+    }
+
+    // Number the open components in order of their first site
+    std::vector<int64_t> expected(rows * cols, -1);
+    std::map<int64_t, int64_t> label_of_root;
+    bool top_bottom = false;
+    for (int i = 0; i < rows * cols; ++i) {
+      if (grid.is_open(i / cols, i % cols)) {
+        int64_t root = sites.find(i);
+        expected[i] = label_of_root.emplace(root, static_cast<int64_t>(label_of_root.size())).first->second;
+      }
+    }
+    for (int top = 0; top < cols; ++top) {
+      for (int bottom = (rows - 1) * cols; bottom < rows * cols; ++bottom) {
+        top_bottom = top_bottom || (expected[top] >= 0 && expected[top] == expected[bottom]);
+      }
+    }
+
+    for (int threads = 1; threads <= 4; threads += 3) {
+      UnionFind::GridLabels labels = UnionFind::label_components(grid, threads);
+      Assert::IsTrue(labels.labels == expected);
+      Assert::AreEqual(labels.components, static_cast<int64_t>(label_of_root.size()));
+      Assert::AreEqual(labels.top_bottom_connected, top_bottom);
+    }
+  }
+
+  TEST_METHOD(TestNodePool) {
+    // A chain longer than one chunk, walked back by parent indices
+    struct Node {
+      uint32_t parent;
+      PuzzleBoard::Move move;
+    };
+    HeuristicSearch::NodePool<Node> pool;
+    const uint32_t length = 70000;
+    uint32_t last = pool.add(Node{ HeuristicSearch::NodePool<Node>::none, PuzzleBoard::Move::up });
+    for (uint32_t i = 1; i < length; ++i) {
+      last = pool.add(Node{ last, static_cast<PuzzleBoard::Move>(i % 4) });
+    }
+    Assert::AreEqual(pool.size(), length);
+
+    uint32_t steps = 0;
+    for (uint32_t i = last; pool[i].parent != HeuristicSearch::NodePool<Node>::none; i = pool[i].parent) {
+      Assert::IsTrue(pool[i].move == static_cast<PuzzleBoard::Move>(i % 4));
+      ++steps;
+    }
+    Assert::AreEqual(steps, length - 1);
+
+    size_t memory = pool.memory();
+    pool.clear();
+    Assert::AreEqual(pool.size(), 0u);
+    Assert::AreEqual(pool.add(Node{ HeuristicSearch::NodePool<Node>::none, PuzzleBoard::Move::up }), 0u);
+    Assert::AreEqual(pool.memory(), memory);
+  }
+
+  TEST_METHOD(TestBatchSolver) {
+    // Shuffled 3x3 boards, about half of them unsolvable
+    std::vector<PuzzleBoard::Board> boards;
+    std::vector<int> tiles = { 1, 2, 3, 4, 5, 6, 7, 8, 0 };
+    std::mt19937 generator(29);
+    for (int i = 0; i < 40; ++i) {
+      std::shuffle(tiles.begin(), tiles.end(), generator);
+      boards.push_back(PuzzleBoard::Board(tiles));
+    }
+    auto solvable = std::count_if(boards.begin(), boards.end(),
+                                  [](const PuzzleBoard::Board& board) { return board.is_solvable(); });
+    Assert::IsTrue(solvable > 0 && solvable < static_cast<long>(boards.size()));
+
+    PuzzleBoard::SolverOptions options;
+    options.heuristic = PuzzleBoard::Heuristic::linear_conflict;
+    for (int mode = 0; mode < 2; ++mode) {
+      options.mode = mode == 0 ? PuzzleBoard::SearchMode::a_star : PuzzleBoard::SearchMode::bidirectional;
+      PuzzleBoard::BatchSolver batch(options, 4);
+      Assert::AreEqual(batch.number_of_threads(), 4);
+      std::vector<PuzzleBoard::BatchResult> results = batch.solve(boards);
+
+      Assert::AreEqual(results.size(), boards.size());
+      for (size_t i = 0; i < boards.size(); ++i) {
+        PuzzleBoard::Solver solver(boards[i], options);
+        Assert::AreEqual(results[i].index, i);
+        Assert::AreEqual(results[i].solvable, solver.is_solvable());
+        Assert::AreEqual(results[i].min_moves, solver.min_moves());
+        Assert::AreEqual(static_cast<int>(results[i].moves.size()), std::max(solver.min_moves(), 0));
+      }
+    }
+
+    // A board too large for walking distance fails on its own, after the
+    // boards before it were solved
+    options.mode = PuzzleBoard::SearchMode::a_star;
+    options.heuristic = PuzzleBoard::Heuristic::walking_distance;
+    std::vector<PuzzleBoard::Board> mixed(boards.begin(), boards.begin() + 5);
+    std::vector<int> large(25);
+    for (int i = 0; i < 24; ++i) {
+      large[i] = i + 1;
+    }
+    mixed.push_back(PuzzleBoard::Board(large));
+    PuzzleBoard::BatchSolver single(options, 1);
+    size_t reported = 0;
+    Assert::ExpectException<std::invalid_argument>([&] {
+      single.solve(mixed, [&](const PuzzleBoard::BatchResult&, const PuzzleBoard::BatchProgress&) { ++reported; });
+    });
+    Assert::AreEqual(reported, static_cast<size_t>(5));
+  }
+
+  TEST_METHOD(TestSolverStats) {
+    // UnitTest is built with PUZZLE_SOLVER_STATS, so the counters are filled
+    int arr[] = { 5, 1, 3, 4, 2, 0, 7, 8, 9, 6, 10, 12, 13, 14, 11, 15 };
+    std::vector<int> tiles(arr, arr + sizeof(arr) / sizeof(int));
+    PuzzleBoard::Board board(tiles);
+    PuzzleBoard::SearchMode modes[] = { PuzzleBoard::SearchMode::a_star, PuzzleBoard::SearchMode::bidirectional };
+    PuzzleBoard::Solver::Workspace workspace;
+
+    for (PuzzleBoard::SearchMode mode : modes) {
+      PuzzleBoard::SolverOptions options;
+      options.mode = mode;
+      PuzzleBoard::Solver first(board, options, workspace);
+      const PuzzleBoard::SolverStats& stats = first.statistics();
+      Assert::IsTrue(stats.nodes_expanded > 0);
+      Assert::IsTrue(stats.nodes_expanded <= stats.nodes_generated);
+      Assert::IsTrue(stats.peak_open_set > 0);
+      Assert::IsTrue(stats.peak_node_memory > 0);
+
+      // Searches are deterministic, with or without a reused workspace
+      PuzzleBoard::Solver again(board, options, workspace);
+      PuzzleBoard::Solver fresh(board, options);
+      for (const PuzzleBoard::Solver* solver : { &again, &fresh }) {
+        const PuzzleBoard::SolverStats& other = solver->statistics();
+        Assert::AreEqual(other.nodes_generated, stats.nodes_generated);
+        Assert::AreEqual(other.nodes_expanded, stats.nodes_expanded);
+        Assert::AreEqual(other.duplicates_pruned, stats.duplicates_pruned);
+        Assert::AreEqual(other.peak_open_set, stats.peak_open_set);
+      }
+    }
+  }
+
+  TEST_METHOD(TestForEachNeighbour) {
+    PuzzleBoard::Heuristic heuristics[] = {
+      PuzzleBoard::Heuristic::hamming, PuzzleBoard::Heuristic::manhattan,
+      PuzzleBoard::Heuristic::linear_conflict, PuzzleBoard::Heuristic::walking_distance
+    };
+    PuzzleBoard::Move moves[] = {
+      PuzzleBoard::Move::up, PuzzleBoard::Move::down, PuzzleBoard::Move::left, PuzzleBoard::Move::right
+    };
+    std::vector<std::vector<int>> boards = {
+      { 5, 1, 3, 4, 2, 0, 7, 8, 9, 6, 10, 12, 13, 14, 11, 15 },  // Empty tile inside
+      { 0, 1, 3, 4, 5, 2, 7, 8, 9, 6, 10, 12, 13, 14, 11, 15 },  // In a corner
+      { 8, 6, 7, 2, 5, 4, 3, 0, 1 }                               // On an edge
+    };
+
+    for (const std::vector<int>& tiles : boards) {
+      PuzzleBoard::Board board(tiles);
+      std::vector<PuzzleBoard::Board> expected = board.neighbours();
+
+      for (PuzzleBoard::Heuristic h : heuristics) {
+        // With no move left out, and then with each possible one
+        for (int excluded = -1; excluded < 4; ++excluded) {
+          if (excluded >= 0 && !board.can_move(moves[excluded])) {
+            continue;
+          }
+
+          // The neighbour is the board itself, moved in place, so everything
+          // about the original board is taken beforehand
+          int value = board.heuristic(h);
+          int positions[4];
+          for (int m = 0; m < 4; ++m) {
+            positions[m] = board.can_move(moves[m]) ? board.moved_tile_position(moves[m]) : -1;
+          }
+
+          std::map<std::string, int> visited;  // Heuristic value of each neighbour
+          auto visit = [&](const PuzzleBoard::Board& neighbour, PuzzleBoard::Move move, int blank, int delta) {
+            Assert::AreEqual(blank, neighbour.blank_position());
+            Assert::AreEqual(blank, positions[static_cast<int>(move)]);
+            visited[neighbour.key()] = value + delta;
+          };
+          if (excluded < 0) {
+            board.for_each_neighbour(h, visit);
+          }
+          else {
+            board.for_each_neighbour(h, moves[excluded], visit);
+          }
+          Assert::AreEqual(board.heuristic(h), value);
+          Assert::IsTrue(board.equals(PuzzleBoard::Board(tiles)));
+
+          PuzzleBoard::Board excluded_board(tiles);
+          if (excluded >= 0) {
+            excluded_board.move(moves[excluded]);
+          }
+          size_t count = 0;
+          for (const PuzzleBoard::Board& neighbour : expected) {
+            bool left_out = excluded >= 0 && excluded_board.equals(neighbour);
+            auto found = visited.find(neighbour.key());
+            Assert::AreEqual(found != visited.end(), !left_out);
+            if (!left_out) {
+              Assert::AreEqual(found->second, neighbour.heuristic(h));
+              ++count;
+            }
+          }
+          Assert::AreEqual(visited.size(), count);
+        }
+      }
+    }
+  }
+
+  TEST_METHOD(TestParallelAStar) {
+    // Solvable shuffled 3x3 boards, and 4x4 boards a random walk away from the goal
+    std::vector<PuzzleBoard::Board> boards;
+    std::mt19937 generator(33);
+    std::vector<int> tiles = { 1, 2, 3, 4, 5, 6, 7, 8, 0 };
+    while (boards.size() < 6) {
+      std::shuffle(tiles.begin(), tiles.end(), generator);
+      if (PuzzleBoard::Board(tiles).is_solvable()) {
+        boards.push_back(PuzzleBoard::Board(tiles));
+      }
+    }
+    PuzzleBoard::Move moves[] = {
+      PuzzleBoard::Move::up, PuzzleBoard::Move::down, PuzzleBoard::Move::left, PuzzleBoard::Move::right
+    };
+    for (int i = 0; i < 6; ++i) {
+      PuzzleBoard::Board board({ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 0 });
+      for (int step = 0; step < 40; ++step) {
+        PuzzleBoard::Move move = moves[generator() % 4];
+        if (board.can_move(move)) {
+          board.move(move);
+        }
+      }
+      boards.push_back(board);
+    }
+
+    PuzzleBoard::SolverOptions options;
+    options.heuristic = PuzzleBoard::Heuristic::linear_conflict;
+    for (const PuzzleBoard::Board& board : boards) {
+      PuzzleBoard::Solver solver(board, options);
+
+      for (int threads : { 1, 2, 4, 7 }) {
+        PuzzleBoard::SolverOptions parallel_options = options;
+        parallel_options.mode = PuzzleBoard::SearchMode::parallel;
+        parallel_options.threads = threads;
+        PuzzleBoard::Solver parallel(board, parallel_options);
+
+        Assert::AreEqual(parallel.min_moves(), solver.min_moves());
+        auto solution = parallel.solution();
+        Assert::AreEqual(static_cast<int>(solution.size()), solver.min_moves() + 1);
+        Assert::IsTrue(solution.front().equals(board));
+        Assert::IsTrue(solution.back().is_goal());
+
+        const PuzzleBoard::SolverStats& stats = parallel.statistics();
+        Assert::IsTrue(solver.min_moves() == 0 || stats.nodes_expanded > 0);
+        Assert::IsTrue(stats.nodes_expanded <= stats.nodes_generated);
+        Assert::IsTrue(solver.min_moves() == 0 || stats.peak_node_memory > 0);
+      }
+    }
+  }
 };
 
 }